@@ -0,0 +1,442 @@
+/*
+ * Vocoder benchmark
+ *
+ * Loads the built plugin with dlopen() the way the host does and times
+ * process_block on synthetic voice and synth signals. Not part of the
+ * module; built and run by scripts/bench.sh, ideally on the Move itself.
+ *
+ * Scenarios:
+ *   tiers  - one instance per quality tier: measured ns/block next to the
+ *            plugin's cpu_cost prediction and its calibrated ns_per_unit
+ *            (the value to use for COST_NS_PER_UNIT)
+ *   stereo - Dual, Spread and M/S at each side bank size, 16 and 32 bands
+ *   fastmath - fastmath.h against libm: ns per value and worst error over
+ *            each function's documented range, then the cost of retuning
+ *            the carrier bank for a formant sweep
+ *   scale  - 1..8 instances with mixed settings sharing one mic input,
+ *            processed in turn per block as the host chain does; reports
+ *            aggregate and per-instance cost and, where perf_event_open is
+ *            allowed, L1D and last-level cache read misses per block
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "audio_fx_api_v1.h"
+#include "fastmath.h"
+
+/* Audio FX API v2, as declared by the plugin */
+typedef struct audio_fx_api_v2 {
+    uint32_t api_version;
+    void* (*create_instance)(const char *module_dir, const char *config_json);
+    void (*destroy_instance)(void *instance);
+    void (*process_block)(void *instance, int16_t *audio_inout, int frames);
+    void (*set_param)(void *instance, const char *key, const char *val);
+    int (*get_param)(void *instance, const char *key, char *buf, int buf_len);
+} audio_fx_api_v2_t;
+
+typedef audio_fx_api_v2_t* (*audio_fx_init_v2_fn)(const host_api_v1_t *host);
+
+#define SAMPLE_RATE 44100
+#define FRAMES 128
+#define MAX_INSTANCES 8
+#define WARMUP_BLOCKS 300
+#define MEASURE_BLOCKS 3000
+
+static uint8_t g_mapped[4096];
+static audio_fx_api_v2_t *g_api;
+
+/* ── Helpers ─────────────────────────────────────────────────────────── */
+
+static void bench_log(const char *msg) {
+    (void)msg;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Apply "key=value,key=value" settings */
+static void apply_settings(void *inst, const char *settings) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", settings);
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        g_api->set_param(inst, tok, eq + 1);
+    }
+}
+
+/* ── Test signals ────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t seed;
+    double voice_phase;
+    double synth_phase;
+    long   frame;
+} signal_state_t;
+
+/* Buzzy vowel-like modulator with noisy consonant bursts, written to the
+ * shared mic input once per block */
+static void fill_mic(signal_state_t *s) {
+    int16_t *mic = (int16_t *)(g_mapped + MOVE_AUDIO_IN_OFFSET);
+    for (int i = 0; i < FRAMES; i++, s->frame++) {
+        s->seed = s->seed * 1664525u + 1013904223u;
+        float noise = (float)(int32_t)s->seed / 2147483648.0f;
+        int syllable = (int)(s->frame / 8820) % 4;   /* 200 ms segments */
+        float x;
+        if (syllable == 3) {
+            x = 0.1f * noise;
+        } else {
+            float saw = (float)(s->voice_phase - floor(s->voice_phase)) * 2.0f - 1.0f;
+            x = 0.3f * saw * (0.6f + 0.4f * sinf((float)s->frame * 0.0005f));
+        }
+        s->voice_phase += (150.0 + 20.0 * syllable) / SAMPLE_RATE;
+        mic[i * 2] = mic[i * 2 + 1] = (int16_t)(x * 32767.0f);
+    }
+}
+
+/* Detuned saw pad carrier, one block per instance */
+static void fill_carrier(signal_state_t *s, int16_t *buf) {
+    for (int i = 0; i < FRAMES; i++) {
+        float a = (float)(s->synth_phase - floor(s->synth_phase)) * 2.0f - 1.0f;
+        float b = (float)(s->synth_phase * 1.006 - floor(s->synth_phase * 1.006)) * 2.0f - 1.0f;
+        s->synth_phase += 110.0 / SAMPLE_RATE;
+        buf[i * 2]     = (int16_t)(0.2f * a * 32767.0f);
+        buf[i * 2 + 1] = (int16_t)(0.2f * b * 32767.0f);
+    }
+}
+
+/* ── Cache counters ──────────────────────────────────────────────────── */
+
+typedef struct {
+    int fd_l1;
+    int fd_ll;
+} cache_counters_t;
+
+static int perf_open(uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = config;
+    attr.disabled = (group < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static int counters_open(cache_counters_t *c) {
+    uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    c->fd_l1 = perf_open(PERF_COUNT_HW_CACHE_L1D | read_miss, -1);
+    c->fd_ll = (c->fd_l1 >= 0) ? perf_open(PERF_COUNT_HW_CACHE_LL | read_miss, c->fd_l1) : -1;
+    return c->fd_l1 >= 0;
+}
+
+static void counters_start(cache_counters_t *c) {
+    if (c->fd_l1 < 0) return;
+    ioctl(c->fd_l1, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(c->fd_l1, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static void counters_stop(cache_counters_t *c, uint64_t *l1, uint64_t *ll) {
+    *l1 = *ll = 0;
+    if (c->fd_l1 < 0) return;
+    ioctl(c->fd_l1, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(c->fd_l1, l1, sizeof(*l1)) != sizeof(*l1)) *l1 = 0;
+    if (c->fd_ll >= 0 && read(c->fd_ll, ll, sizeof(*ll)) != sizeof(*ll)) *ll = 0;
+}
+
+static void counters_close(cache_counters_t *c) {
+    if (c->fd_ll >= 0) close(c->fd_ll);
+    if (c->fd_l1 >= 0) close(c->fd_l1);
+}
+
+/* ── Scenarios ───────────────────────────────────────────────────────── */
+
+/* Mean process_block time of one instance on its own */
+static double time_instance(void *inst) {
+    signal_state_t sig = { 1, 0.0, 0.0, 0 };
+    int16_t buf[FRAMES * 2];
+    uint64_t total = 0;
+    for (int blk = 0; blk < WARMUP_BLOCKS + MEASURE_BLOCKS; blk++) {
+        fill_mic(&sig);
+        fill_carrier(&sig, buf);
+        uint64_t t0 = now_ns();
+        g_api->process_block(inst, buf, FRAMES);
+        if (blk >= WARMUP_BLOCKS) total += now_ns() - t0;
+    }
+    return (double)total / MEASURE_BLOCKS;
+}
+
+static const char *const g_tiers[] = { "Eco", "Standard", "High", "Ultra" };
+
+static void bench_tiers(void) {
+    printf("\n== tiers: one instance per quality tier ==\n");
+    printf("%-10s %12s %12s %12s\n", "tier", "ns/block", "cpu_cost", "ns/unit");
+
+    for (size_t t = 0; t < sizeof(g_tiers) / sizeof(g_tiers[0]); t++) {
+        void *inst = g_api->create_instance(".", NULL);
+        g_api->set_param(inst, "cpu_budget", "100");
+        g_api->set_param(inst, "quality", g_tiers[t]);
+        double ns = time_instance(inst);
+
+        char cost[64], profile[256];
+        g_api->get_param(inst, "cpu_cost", cost, sizeof(cost));
+        g_api->get_param(inst, "profile", profile, sizeof(profile));
+        const char *unit = strstr(profile, "\"ns_per_unit\":");
+        printf("%-10s %12.0f %12s %12.3f\n", g_tiers[t], ns, cost,
+               unit ? atof(unit + strlen("\"ns_per_unit\":")) : 0.0);
+        g_api->destroy_instance(inst);
+    }
+}
+
+static const char *const g_stereo_modes[] = {
+    "stereo=Dual",
+    "stereo=Spread",
+    "stereo=M/S,side_bands=1/2",
+    "stereo=M/S,side_bands=1/4",
+    "stereo=M/S,side_bands=1/8",
+};
+
+static void bench_stereo(void) {
+    printf("\n== stereo: carrier bank layouts ==\n");
+    printf("%-28s %6s %12s %12s\n", "mode", "bands", "ns/block", "cpu_cost");
+
+    static const char *const bands[] = { "16", "32" };
+    for (int b = 0; b < 2; b++) {
+        for (size_t m = 0; m < sizeof(g_stereo_modes) / sizeof(g_stereo_modes[0]); m++) {
+            void *inst = g_api->create_instance(".", NULL);
+            g_api->set_param(inst, "cpu_budget", "100");
+            g_api->set_param(inst, "bands", bands[b]);
+            apply_settings(inst, g_stereo_modes[m]);
+            double ns = time_instance(inst);
+
+            char cost[64];
+            g_api->get_param(inst, "cpu_cost", cost, sizeof(cost));
+            printf("%-28s %6s %12.0f %12s\n", g_stereo_modes[m], bands[b], ns, cost);
+            g_api->destroy_instance(inst);
+        }
+    }
+}
+
+/* Each case times a loop over FM_N inputs, once with the approximation and
+ * once with libm, so both get the same chance to vectorize */
+#define FM_N 4096
+#define FM_REPS 2000
+
+typedef enum { ERR_ABS, ERR_REL } err_kind_t;
+
+#define FM_CASE(name, fast_expr, libm_expr, ref_expr)                          \
+    static void fm_fast_##name(const float *x, float *y) {                     \
+        for (int i = 0; i < FM_N; i++) { float a = x[i]; y[i] = (fast_expr); } \
+    }                                                                          \
+    static void fm_libm_##name(const float *x, float *y) {                     \
+        for (int i = 0; i < FM_N; i++) { float a = x[i]; y[i] = (libm_expr); } \
+    }                                                                          \
+    static double fm_ref_##name(double a) { return (ref_expr); }
+
+FM_CASE(sqrt, fast_sqrt(a), sqrtf(a), sqrt(a))
+FM_CASE(log2, fast_log2(a), log2f(a), log2(a))
+FM_CASE(exp2, fast_exp2(a), exp2f(a), exp2(a))
+FM_CASE(sin,  fast_sin(a),  sinf(a),  sin(a))
+FM_CASE(tan,  fast_tan(a),  tanf(a),  tan(a))
+
+typedef struct {
+    const char *name;
+    void (*fast)(const float *, float *);
+    void (*libm)(const float *, float *);
+    double (*ref)(double);
+    float lo, hi;
+    err_kind_t err;
+} fm_case_t;
+
+static const fm_case_t g_fm_cases[] = {
+    { "sqrt", fm_fast_sqrt, fm_libm_sqrt, fm_ref_sqrt, 1e-3f, 100.0f, ERR_REL },
+    { "log2", fm_fast_log2, fm_libm_log2, fm_ref_log2, 1e-3f, 100.0f, ERR_ABS },
+    { "exp2", fm_fast_exp2, fm_libm_exp2, fm_ref_exp2, -20.0f, 20.0f, ERR_REL },
+    { "sin",  fm_fast_sin,  fm_libm_sin,  fm_ref_sin,  -3.1415927f, 3.1415927f, ERR_ABS },
+    { "tan",  fm_fast_tan,  fm_libm_tan,  fm_ref_tan,  1e-4f, 1.4137167f, ERR_REL },
+};
+
+static double fm_time(void (*fn)(const float *, float *), const float *x, float *y) {
+    uint64_t t0 = now_ns();
+    for (int r = 0; r < FM_REPS; r++) {
+        fn(x, y);
+        __asm__ volatile("" : : "r"(y) : "memory");
+    }
+    return (double)(now_ns() - t0) / ((double)FM_REPS * FM_N);
+}
+
+static void bench_fastmath(void) {
+    static float x[FM_N], y[FM_N];
+
+    printf("\n== fastmath: approximations against libm ==\n");
+    printf("%-6s %22s %10s %10s %8s %12s\n", "fn", "range", "fast ns", "libm ns",
+           "speedup", "max error");
+
+    for (size_t c = 0; c < sizeof(g_fm_cases) / sizeof(g_fm_cases[0]); c++) {
+        const fm_case_t *fc = &g_fm_cases[c];
+        for (int i = 0; i < FM_N; i++)
+            x[i] = fc->lo + (fc->hi - fc->lo) * (float)i / (float)(FM_N - 1);
+
+        double t_fast = fm_time(fc->fast, x, y);
+        double err = 0.0;
+        for (int i = 0; i < FM_N; i++) {
+            double ref = fc->ref(x[i]);
+            double e = fabs((double)y[i] - ref);
+            if (fc->err == ERR_REL) e /= fabs(ref);
+            if (e > err) err = e;
+        }
+        double t_libm = fm_time(fc->libm, x, y);
+
+        char range[32];
+        snprintf(range, sizeof(range), "[%g, %g]", fc->lo, fc->hi);
+        printf("%-6s %22s %10.2f %10.2f %7.1fx %9.2e %s\n", fc->name, range,
+               t_fast, t_libm, t_libm / t_fast, err, fc->err == ERR_REL ? "rel" : "abs");
+    }
+
+    printf("\nformant sweep, Standard tier:\n");
+    static const char *const sweeps[] = {
+        "formant=0",
+        "formant=5",
+        "sweep_depth=6,sweep_rate=4",
+    };
+    for (size_t s = 0; s < sizeof(sweeps) / sizeof(sweeps[0]); s++) {
+        void *inst = g_api->create_instance(".", NULL);
+        g_api->set_param(inst, "cpu_budget", "100");
+        apply_settings(inst, sweeps[s]);
+        printf("%-28s %12.0f ns/block\n", sweeps[s], time_instance(inst));
+        g_api->destroy_instance(inst);
+    }
+}
+
+/* Settings cycled across instances in the scaling run */
+static const char *const g_mixes[] = {
+    "quality=Standard",
+    "quality=High,whiten=0.5",
+    "quality=Eco,gate=0.5",
+    "quality=Ultra,detector=RMS",
+};
+
+static void bench_scale(void) {
+    cache_counters_t counters;
+    int have_counters = counters_open(&counters);
+
+    printf("\n== scale: 1..%d instances, shared mic input ==\n", MAX_INSTANCES);
+    if (!have_counters)
+        printf("(perf_event_open unavailable, cache misses not reported)\n");
+    printf("%-4s %12s %12s %14s %10s %10s  %s\n", "n", "ns/block", "ns/inst",
+           "inst0 ns", "L1D miss", "LL miss", "per-instance ns");
+
+    double base_inst0 = 0.0;
+    for (int n = 1; n <= MAX_INSTANCES; n++) {
+        void *inst[MAX_INSTANCES];
+        signal_state_t sig[MAX_INSTANCES];
+        for (int k = 0; k < n; k++) {
+            inst[k] = g_api->create_instance(".", NULL);
+            apply_settings(inst[k], g_mixes[k % (int)(sizeof(g_mixes) / sizeof(g_mixes[0]))]);
+            sig[k] = (signal_state_t){ 1, 0.0, 0.01 * k, 0 };
+        }
+        /* Keep the coordinator from degrading anyone mid-measurement */
+        g_api->set_param(inst[0], "cpu_budget", "100");
+
+        int16_t buf[FRAMES * 2];
+        uint64_t inst_ns[MAX_INSTANCES] = { 0 };
+        uint64_t total = 0, l1 = 0, ll = 0;
+        for (int blk = 0; blk < WARMUP_BLOCKS + MEASURE_BLOCKS; blk++) {
+            int measure = (blk >= WARMUP_BLOCKS);
+            if (blk == WARMUP_BLOCKS) counters_start(&counters);
+
+            fill_mic(&sig[0]);
+            uint64_t b0 = now_ns();
+            for (int k = 0; k < n; k++) {
+                fill_carrier(&sig[k], buf);
+                uint64_t t0 = now_ns();
+                g_api->process_block(inst[k], buf, FRAMES);
+                if (measure) inst_ns[k] += now_ns() - t0;
+            }
+            /* Carrier synthesis is inside this window; it is small next to the vocoder */
+            if (measure) total += now_ns() - b0;
+        }
+        counters_stop(&counters, &l1, &ll);
+
+        double inst0 = (double)inst_ns[0] / MEASURE_BLOCKS;
+        if (n == 1) base_inst0 = inst0;
+        printf("%-4d %12.0f %12.0f %7.0f %+4.0f%% %10.1f %10.1f ", n,
+               (double)total / MEASURE_BLOCKS, (double)total / MEASURE_BLOCKS / n,
+               inst0, 100.0 * (inst0 / base_inst0 - 1.0),
+               (double)l1 / MEASURE_BLOCKS, (double)ll / MEASURE_BLOCKS);
+        for (int k = 0; k < n; k++)
+            printf(" %.0f", (double)inst_ns[k] / MEASURE_BLOCKS);
+        printf("\n");
+
+        char level[32];
+        for (int k = 0; k < n; k++) {
+            g_api->get_param(inst[k], "cpu_level", level, sizeof(level));
+            if (strcmp(level, "Full") != 0)
+                printf("  warning: instance %d degraded to %s\n", k, level);
+        }
+        for (int k = 0; k < n; k++)
+            g_api->destroy_instance(inst[k]);
+    }
+
+    counters_close(&counters);
+}
+
+/* ── Main ────────────────────────────────────────────────────────────── */
+
+int main(int argc, char **argv) {
+    const char *so_path = (argc > 1) ? argv[1] : "build/vocoder.so";
+    const char *scenario = (argc > 2) ? argv[2] : "all";
+
+    void *so = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!so) {
+        fprintf(stderr, "dlopen %s: %s\n", so_path, dlerror());
+        return 1;
+    }
+    audio_fx_init_v2_fn init = (audio_fx_init_v2_fn)dlsym(so, "move_audio_fx_init_v2");
+    if (!init) {
+        fprintf(stderr, "move_audio_fx_init_v2 not found in %s\n", so_path);
+        return 1;
+    }
+
+    static host_api_v1_t host;
+    host.api_version = 1;
+    host.sample_rate = SAMPLE_RATE;
+    host.frames_per_block = FRAMES;
+    host.mapped_memory = g_mapped;
+    host.audio_out_offset = MOVE_AUDIO_OUT_OFFSET;
+    host.audio_in_offset = MOVE_AUDIO_IN_OFFSET;
+    host.log = bench_log;
+    g_api = init(&host);
+    if (!g_api) {
+        fprintf(stderr, "plugin init failed\n");
+        return 1;
+    }
+
+    printf("block budget: %.0f ns (%d frames at %d Hz)\n",
+           1e9 * FRAMES / SAMPLE_RATE, FRAMES, SAMPLE_RATE);
+
+    int all = (strcmp(scenario, "all") == 0);
+    if (all || strcmp(scenario, "tiers") == 0) bench_tiers();
+    if (all || strcmp(scenario, "stereo") == 0) bench_stereo();
+    if (all || strcmp(scenario, "fastmath") == 0) bench_fastmath();
+    if (all || strcmp(scenario, "scale") == 0) bench_scale();
+
+    dlclose(so);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+# Build and run the Vocoder benchmark natively.
+#
+# Run on the Move (or any Linux box) from the repo root:
+#   ./scripts/bench.sh [tiers|stereo|fastmath|scale|all]
+# Set CROSS_PREFIX to cross-compile instead, then copy build/bench and
+# build/vocoder.so to the device and run ./bench vocoder.so there.
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+CC="${CROSS_PREFIX}gcc"
+
+cd "$REPO_ROOT"
+mkdir -p build
+
+echo "Compiling DSP plugin..."
+${CC} -Ofast -shared -fPIC \
+    -fomit-frame-pointer -fno-stack-protector \
+    -DNDEBUG \
+    src/dsp/vocoder.c \
+    -o build/vocoder.so \
+    -Isrc/dsp \
+    -lm -lpthread
+
+echo "Compiling benchmark..."
+${CC} -Ofast \
+    scripts/bench.c \
+    -o build/bench \
+    -Isrc/dsp \
+    -lm -ldl
+
+if [ -n "$CROSS_PREFIX" ]; then
+    echo "Cross-compiled: copy build/bench and build/vocoder.so to the device"
+    exit 0
+fi
+
+./build/bench build/vocoder.so "${1:-all}"
@@ -0,0 +1,510 @@
+/*
+ * Vocoder parameter-storm harness
+ *
+ * Loads the built plugin with dlopen() and runs process_block on a
+ * real-time thread at the 128-frame cadence while control threads hammer
+ * the instance the way automation, UI polling and preset loads do:
+ *
+ *   automation - set_param on random chain_params keys with random values
+ *   poller     - get_param on random parameter, metadata and meter keys
+ *   presets    - state and dsp_snapshot round trips between saved slots
+ *
+ * Reports block time and wake-up jitter, deadline misses and output
+ * discontinuities, comparing a quiet phase against the storm. Built and
+ * run by scripts/storm.sh; TSAN=1 builds both sides with ThreadSanitizer
+ * so data races on instance fields are reported as they happen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "audio_fx_api_v1.h"
+
+/* Audio FX API v2, as declared by the plugin */
+typedef struct audio_fx_api_v2 {
+    uint32_t api_version;
+    void* (*create_instance)(const char *module_dir, const char *config_json);
+    void (*destroy_instance)(void *instance);
+    void (*process_block)(void *instance, int16_t *audio_inout, int frames);
+    void (*set_param)(void *instance, const char *key, const char *val);
+    int (*get_param)(void *instance, const char *key, char *buf, int buf_len);
+} audio_fx_api_v2_t;
+
+typedef audio_fx_api_v2_t* (*audio_fx_init_v2_fn)(const host_api_v1_t *host);
+
+#define SAMPLE_RATE 44100
+#define FRAMES 128
+#define QUIET_SECONDS 2
+#define MAX_PARAMS 96
+#define MAX_OPTIONS 16
+#define PRESET_SLOTS 4
+#define CLICK_RATIO 12.0f      /* second difference over the level around it */
+#define CLICK_FLOOR 0.002f     /* ignore steps below this, full scale 1 */
+#define CLICK_WARMUP 4410      /* samples before the detector's mean settles */
+#define CLICK_AFTER 64         /* samples after a step that give the level there */
+#define WAVE_SIZE 4096
+#define WAVE_HARMONICS 30
+
+static uint8_t g_mapped[4096];
+static audio_fx_api_v2_t *g_api;
+static void *g_inst;
+static atomic_int g_storm;     /* control threads run while set */
+static atomic_int g_running;
+static atomic_int g_last_set = -1; /* g_params index automation set last */
+static long g_clicks_by_key[MAX_PARAMS];
+static long g_set_interval_ns = 50000;
+static float g_wave[WAVE_SIZE]; /* band-limited saw, so the inputs have no edges */
+
+/* ── Helpers ─────────────────────────────────────────────────────────── */
+
+static void storm_log(const char *msg) {
+    (void)msg;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(long ns) {
+    struct timespec ts = { 0, ns };
+    nanosleep(&ts, NULL);
+}
+
+static inline uint32_t rand_next(uint32_t *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static inline float rand_unit(uint32_t *s) {
+    return (float)(rand_next(s) >> 8) / 16777216.0f;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* ── Parameter table, read from chain_params ─────────────────────────── */
+
+typedef struct {
+    char  key[32];
+    int   n_opts;              /* > 0 for enums */
+    char  opts[MAX_OPTIONS][16];
+    float min, max;
+} storm_param_t;
+
+static storm_param_t g_params[MAX_PARAMS];
+static int g_param_count;
+
+static const char *json_field(const char *obj, const char *end, const char *name) {
+    char pat[40];
+    snprintf(pat, sizeof(pat), "\"%s\":", name);
+    const char *p = strstr(obj, pat);
+    return (p && p < end) ? p + strlen(pat) : NULL;
+}
+
+/* One entry per {...} object; options arrays hold no braces */
+static void load_params(void) {
+    static char json[16384];
+    if (g_api->get_param(g_inst, "chain_params", json, sizeof(json)) < 0) {
+        fprintf(stderr, "chain_params unavailable\n");
+        exit(1);
+    }
+    for (const char *p = strchr(json, '{'); p && g_param_count < MAX_PARAMS;
+         p = strchr(p + 1, '{')) {
+        const char *end = strchr(p, '}');
+        if (!end) break;
+        storm_param_t *sp = &g_params[g_param_count];
+        memset(sp, 0, sizeof(*sp));
+
+        const char *k = json_field(p, end, "key");
+        if (!k || sscanf(k, "\"%31[^\"]\"", sp->key) != 1) continue;
+        const char *o = json_field(p, end, "options");
+        if (o) {
+            for (o = strchr(o, '"'); o && o < end && sp->n_opts < MAX_OPTIONS;
+                 o = strchr(o + 1, '"')) {
+                if (sscanf(o, "\"%15[^\"]\"", sp->opts[sp->n_opts]) != 1) break;
+                sp->n_opts++;
+                o = strchr(o + 1, '"');
+                if (!o) break;
+            }
+        } else {
+            const char *mn = json_field(p, end, "min");
+            const char *mx = json_field(p, end, "max");
+            sp->min = mn ? (float)atof(mn) : 0.0f;
+            sp->max = mx ? (float)atof(mx) : 1.0f;
+        }
+        g_param_count++;
+    }
+}
+
+/* ── Audio thread ────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint64_t *proc_ns;     /* per block */
+    uint64_t *late_ns;     /* wake-up lateness per block */
+    long   blocks;
+    long   storm_start;    /* first block with the storm running */
+    long   misses[2];      /* quiet, storm */
+    long   clicks[2];
+    float  worst_click[2];
+} audio_stats_t;
+
+typedef struct {
+    uint32_t seed;
+    double voice_phase;
+    double synth_phase;
+    long   frame;
+    float  prev[2][2];     /* last two output samples per channel */
+    float  d2_avg[2];      /* running mean of |second difference| */
+    float  d2[2][2 * FRAMES];        /* |second difference|, last two blocks */
+    float  d2_before[2][2 * FRAMES]; /* running mean up to each sample */
+    unsigned char clipped[2][2 * FRAMES]; /* difference spans a full-scale sample */
+    int    since_clip[2];  /* samples since the last full-scale one */
+    int    judge_phase;    /* phase of the older block, -1 before the first */
+    int    judge_key;      /* key automation had set last by then */
+} audio_state_t;
+
+static void build_wave(void) {
+    for (int i = 0; i < WAVE_SIZE; i++) {
+        double x = 0.0;
+        for (int h = 1; h <= WAVE_HARMONICS; h++)
+            x += sin(2.0 * M_PI * h * i / WAVE_SIZE) / h;
+        g_wave[i] = (float)(x * 0.55);
+    }
+}
+
+static inline float wave_at(double phase) {
+    double p = (phase - floor(phase)) * WAVE_SIZE;
+    int i = (int)p;
+    float t = (float)(p - i);
+    return g_wave[i] + (g_wave[(i + 1) & (WAVE_SIZE - 1)] - g_wave[i]) * t;
+}
+
+/* Buzzy vowel-like modulator with noisy consonant bursts, as in the bench
+ * but band-limited and with the bursts faded in and out over 10 ms: a
+ * saw's wrap or a burst's edge would read as a click */
+static void fill_inputs(audio_state_t *s, int16_t *buf) {
+    int16_t *mic = (int16_t *)(g_mapped + MOVE_AUDIO_IN_OFFSET);
+    for (int i = 0; i < FRAMES; i++, s->frame++) {
+        float noise = (float)(int32_t)rand_next(&s->seed) / 2147483648.0f;
+        int syllable = (int)(s->frame / 8820) % 4;
+        long pos = s->frame % 8820;
+        float burst = 0.0f;
+        if (syllable == 3) {
+            long edge = pos < 8820 - pos ? pos : 8820 - pos;
+            burst = edge >= 441 ? 1.0f : (float)edge / 441.0f;
+        }
+        float x = (1.0f - burst) * 0.3f * wave_at(s->voice_phase) + burst * 0.1f * noise;
+        s->voice_phase += (150.0 + 20.0 * syllable) / SAMPLE_RATE;
+        mic[i * 2] = mic[i * 2 + 1] = (int16_t)(x * 32767.0f);
+
+        float a = wave_at(s->synth_phase);
+        s->synth_phase += 110.0 / SAMPLE_RATE;
+        buf[i * 2] = buf[i * 2 + 1] = (int16_t)(0.2f * a * 32767.0f);
+    }
+}
+
+/*
+ * Count samples whose second difference jumps far above the level on both
+ * sides of them: the running mean before and the mean over the next
+ * CLICK_AFTER samples, so a change to a louder or brighter sound is not
+ * counted as a click. Differences spanning a full-scale sample are the
+ * output clamping an overload, not clicks, and are skipped. Samples are
+ * judged a block late, once the level after them is known.
+ */
+static void detect_clicks(audio_state_t *s, const int16_t *buf, audio_stats_t *st, int phase) {
+    int judge = (s->judge_phase >= 0 && s->frame > CLICK_WARMUP + FRAMES);
+    for (int c = 0; c < 2; c++) {
+        float *d2 = s->d2[c];
+        float *before = s->d2_before[c];
+        unsigned char *clipped = s->clipped[c];
+        memmove(d2, d2 + FRAMES, FRAMES * sizeof(float));
+        memmove(before, before + FRAMES, FRAMES * sizeof(float));
+        memmove(clipped, clipped + FRAMES, FRAMES);
+        for (int i = 0; i < FRAMES; i++) {
+            int16_t x = buf[i * 2 + c];
+            float y = x / 32768.0f;
+            float d = fabsf(y - 2.0f * s->prev[c][0] + s->prev[c][1]);
+            if (x >= 32767 || x <= -32767)
+                s->since_clip[c] = 0;
+            else if (s->since_clip[c] < 3)
+                s->since_clip[c]++;
+            d2[FRAMES + i] = d;
+            clipped[FRAMES + i] = s->since_clip[c] < 3;
+            before[FRAMES + i] = s->d2_avg[c];
+            s->d2_avg[c] += (d - s->d2_avg[c]) * 0.002f;
+            s->prev[c][1] = s->prev[c][0];
+            s->prev[c][0] = y;
+        }
+        if (!judge) continue;
+
+        /* A step shows in two neighbouring differences; the level after
+         * it starts past both */
+        float after = 0.0f;
+        for (int i = 2; i < 2 + CLICK_AFTER; i++)
+            after += d2[i];
+        for (int i = 0; i < FRAMES; i++) {
+            float level = fmaxf(before[i], after * (1.0f / CLICK_AFTER));
+            float ratio = d2[i] / (level + 1e-6f);
+            if (!clipped[i] && d2[i] > CLICK_FLOOR && ratio > CLICK_RATIO) {
+                int p = s->judge_phase;
+                st->clicks[p]++;
+                if (p && s->judge_key >= 0) g_clicks_by_key[s->judge_key]++;
+                if (ratio > st->worst_click[p]) st->worst_click[p] = ratio;
+            }
+            after += d2[i + 2 + CLICK_AFTER] - d2[i + 2];
+        }
+    }
+    s->judge_phase = phase;
+    s->judge_key = atomic_load_explicit(&g_last_set, memory_order_relaxed);
+}
+
+static void *audio_main(void *arg) {
+    audio_stats_t *st = (audio_stats_t *)arg;
+    audio_state_t s;
+    memset(&s, 0, sizeof(s));
+    s.seed = 1;
+    s.judge_phase = -1;
+
+    const uint64_t period = 1000000000ull * FRAMES / SAMPLE_RATE;
+    int16_t buf[FRAMES * 2];
+    uint64_t next = now_ns() + period;
+    st->storm_start = -1;
+
+    for (long blk = 0; blk < st->blocks; blk++) {
+        struct timespec ts = { (time_t)(next / 1000000000ull), (long)(next % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        uint64_t wake = now_ns();
+        int phase = atomic_load(&g_storm);
+        if (phase && st->storm_start < 0) st->storm_start = blk;
+
+        fill_inputs(&s, buf);
+        uint64_t t0 = now_ns();
+        g_api->process_block(g_inst, buf, FRAMES);
+        uint64_t t1 = now_ns();
+
+        st->proc_ns[blk] = t1 - t0;
+        st->late_ns[blk] = wake - next;
+        if (t1 > next + period) st->misses[phase]++;
+        detect_clicks(&s, buf, st, phase);
+
+        next += period;
+        if (t1 > next) next = t1 + period / 2;  /* skip, don't burst to catch up */
+    }
+    atomic_store(&g_running, 0);
+    return NULL;
+}
+
+/* ── Control threads ─────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t seed;
+    long   ops;
+} control_t;
+
+static void *automation_main(void *arg) {
+    control_t *c = (control_t *)arg;
+    char val[32];
+    while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_storm)) { sleep_ns(1000000); continue; }
+        int k = (int)(rand_next(&c->seed) % (uint32_t)g_param_count);
+        const storm_param_t *p = &g_params[k];
+        if (p->n_opts > 0)
+            snprintf(val, sizeof(val), "%s", p->opts[rand_next(&c->seed) % p->n_opts]);
+        else
+            snprintf(val, sizeof(val), "%.3f", p->min + (p->max - p->min) * rand_unit(&c->seed));
+        g_api->set_param(g_inst, p->key, val);
+        atomic_store_explicit(&g_last_set, k, memory_order_relaxed);
+        c->ops++;
+        sleep_ns(g_set_interval_ns);
+    }
+    return NULL;
+}
+
+static const char *const g_poll_keys[] = {
+    "state", "chain_params", "ui_hierarchy", "param_version", "profile",
+    "cpu_cost", "cpu_level", "cpu_total", "input_level", "agc_gain",
+    "active_bands", "band_centers", "pitch_hz", "pitch_conf", "align_status",
+    "latency_samples", "engine",
+};
+
+static void *poller_main(void *arg) {
+    control_t *c = (control_t *)arg;
+    static char buf[16384];
+    int n_fixed = (int)(sizeof(g_poll_keys) / sizeof(g_poll_keys[0]));
+    while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_storm)) { sleep_ns(1000000); continue; }
+        int k = (int)(rand_next(&c->seed) % (uint32_t)(n_fixed + g_param_count));
+        const char *key = (k < n_fixed) ? g_poll_keys[k] : g_params[k - n_fixed].key;
+        g_api->get_param(g_inst, key, buf, sizeof(buf));
+        c->ops++;
+        sleep_ns(10000);
+    }
+    return NULL;
+}
+
+static void *presets_main(void *arg) {
+    control_t *c = (control_t *)arg;
+    static char slots[PRESET_SLOTS][4096];
+    static char snap[65536];
+    int have_snap = 0;
+    for (int i = 0; i < PRESET_SLOTS; i++)
+        g_api->get_param(g_inst, "state", slots[i], sizeof(slots[i]));
+
+    while (atomic_load(&g_running)) {
+        if (!atomic_load(&g_storm)) { sleep_ns(1000000); continue; }
+        int slot = (int)(rand_next(&c->seed) % PRESET_SLOTS);
+        switch (rand_next(&c->seed) % 4) {
+        case 0:
+            g_api->get_param(g_inst, "state", slots[slot], sizeof(slots[slot]));
+            break;
+        case 1:
+            g_api->set_param(g_inst, "state", slots[slot]);
+            break;
+        case 2:
+            have_snap = g_api->get_param(g_inst, "dsp_snapshot", snap, sizeof(snap)) > 0;
+            break;
+        default:
+            if (have_snap) g_api->set_param(g_inst, "dsp_snapshot", snap);
+            break;
+        }
+        c->ops++;
+        sleep_ns(5000000);
+    }
+    return NULL;
+}
+
+/* ── Main ────────────────────────────────────────────────────────────── */
+
+static void report(const char *name, uint64_t *v, long n) {
+    if (n <= 0) return;
+    qsort(v, (size_t)n, sizeof(v[0]), cmp_u64);
+    double sum = 0.0;
+    for (long i = 0; i < n; i++) sum += (double)v[i];
+    printf("  %-14s mean %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f us\n", name,
+           sum / (double)n / 1e3, v[n / 2] / 1e3, v[n * 99 / 100] / 1e3, v[n - 1] / 1e3);
+}
+
+int main(int argc, char **argv) {
+    const char *so_path = (argc > 1) ? argv[1] : "build/vocoder.so";
+    int seconds = (argc > 2) ? atoi(argv[2]) : 10;
+    if (seconds < 1) seconds = 1;
+    int set_rate = (argc > 3) ? atoi(argv[3]) : 20000;
+    if (set_rate > 0) g_set_interval_ns = 1000000000L / set_rate;
+
+    void *so = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if (!so) {
+        fprintf(stderr, "dlopen %s: %s\n", so_path, dlerror());
+        return 1;
+    }
+    audio_fx_init_v2_fn init = (audio_fx_init_v2_fn)dlsym(so, "move_audio_fx_init_v2");
+    if (!init) {
+        fprintf(stderr, "move_audio_fx_init_v2 not found in %s\n", so_path);
+        return 1;
+    }
+
+    static host_api_v1_t host;
+    host.api_version = 1;
+    host.sample_rate = SAMPLE_RATE;
+    host.frames_per_block = FRAMES;
+    host.mapped_memory = g_mapped;
+    host.audio_out_offset = MOVE_AUDIO_OUT_OFFSET;
+    host.audio_in_offset = MOVE_AUDIO_IN_OFFSET;
+    host.log = storm_log;
+    g_api = init(&host);
+    if (!g_api || !(g_inst = g_api->create_instance(".", NULL))) {
+        fprintf(stderr, "plugin init failed\n");
+        return 1;
+    }
+    load_params();
+    build_wave();
+
+    audio_stats_t st;
+    memset(&st, 0, sizeof(st));
+    st.blocks = (long)(QUIET_SECONDS + seconds) * SAMPLE_RATE / FRAMES;
+    st.proc_ns = (uint64_t *)calloc((size_t)st.blocks, sizeof(uint64_t));
+    st.late_ns = (uint64_t *)calloc((size_t)st.blocks, sizeof(uint64_t));
+    atomic_store(&g_running, 1);
+
+    /* SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit; fall back to normal */
+    pthread_t audio;
+    pthread_attr_t attr;
+    struct sched_param sp = { .sched_priority = 80 };
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &sp);
+    int rt = (pthread_create(&audio, &attr, audio_main, &st) == 0);
+    if (!rt && pthread_create(&audio, NULL, audio_main, &st) != 0) {
+        fprintf(stderr, "cannot start audio thread\n");
+        return 1;
+    }
+    pthread_attr_destroy(&attr);
+
+    control_t ctl[3] = { { 0x1234567u, 0 }, { 0x89abcdeu, 0 }, { 0x5eed5u, 0 } };
+    pthread_t threads[3];
+    pthread_create(&threads[0], NULL, automation_main, &ctl[0]);
+    pthread_create(&threads[1], NULL, poller_main, &ctl[1]);
+    pthread_create(&threads[2], NULL, presets_main, &ctl[2]);
+
+    printf("%d params, %ds quiet then %ds storm, audio thread %s\n", g_param_count,
+           QUIET_SECONDS, seconds, rt ? "SCHED_FIFO 80" : "not real-time (no permission)");
+    sleep(QUIET_SECONDS);
+    atomic_store(&g_storm, 1);
+
+    pthread_join(audio, NULL);
+    for (int i = 0; i < 3; i++)
+        pthread_join(threads[i], NULL);
+
+    long quiet = (st.storm_start < 0) ? st.blocks : st.storm_start;
+    long storm = st.blocks - quiet;
+    double budget_us = 1e6 * FRAMES / SAMPLE_RATE;
+    printf("\ncontrol ops: %ld set, %ld get, %ld preset (%.0f/s total)\n",
+           ctl[0].ops, ctl[1].ops, ctl[2].ops,
+           (double)(ctl[0].ops + ctl[1].ops + ctl[2].ops) / seconds);
+    printf("block budget %.0f us\n", budget_us);
+    printf("quiet (%ld blocks): %ld deadline misses, %ld clicks (worst %.0fx)\n",
+           quiet, st.misses[0], st.clicks[0], st.worst_click[0]);
+    report("block time", st.proc_ns, quiet);
+    report("wake jitter", st.late_ns, quiet);
+    printf("storm (%ld blocks): %ld deadline misses, %ld clicks (worst %.0fx)\n",
+           storm, st.misses[1], st.clicks[1], st.worst_click[1]);
+    report("block time", st.proc_ns + quiet, storm);
+    report("wake jitter", st.late_ns + quiet, storm);
+
+    /* Clicks charged to whichever key automation set last; only meaningful
+     * when sets are sparser than blocks (set_rate below ~340), and preset
+     * loads in between are charged to it too */
+    printf("clicks by last automated key:");
+    for (int shown = 0; shown < 8; shown++) {
+        int best = -1;
+        for (int k = 0; k < g_param_count; k++)
+            if (g_clicks_by_key[k] > 0 && (best < 0 || g_clicks_by_key[k] > g_clicks_by_key[best]))
+                best = k;
+        if (best < 0) break;
+        printf(" %s %ld", g_params[best].key, g_clicks_by_key[best]);
+        g_clicks_by_key[best] = 0;
+    }
+    printf("\n");
+
+    g_api->destroy_instance(g_inst);
+    free(st.proc_ns);
+    free(st.late_ns);
+    dlclose(so);
+    return 0;
+}
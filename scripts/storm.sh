@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Build and run the Vocoder parameter-storm harness natively.
+#
+# Run from the repo root:
+#   ./scripts/storm.sh [seconds] [sets per second]
+# Set TSAN=1 to build plugin and harness with ThreadSanitizer, which
+# reports data races between the audio thread and the control threads.
+# Real-time scheduling needs CAP_SYS_NICE or an rtprio limit (ulimit -r).
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_ROOT="$(dirname "$SCRIPT_DIR")"
+CC="${CROSS_PREFIX}gcc"
+CFLAGS="-O2"
+if [ -n "$TSAN" ]; then
+    CFLAGS="-O1 -g -fsanitize=thread"
+fi
+
+cd "$REPO_ROOT"
+mkdir -p build
+
+echo "Compiling DSP plugin..."
+${CC} ${CFLAGS} -shared -fPIC \
+    src/dsp/vocoder.c \
+    -o build/vocoder.so \
+    -Isrc/dsp \
+    -lm -lpthread
+
+echo "Compiling storm harness..."
+${CC} ${CFLAGS} \
+    scripts/storm.c \
+    -o build/storm \
+    -Isrc/dsp \
+    -lm -ldl -lpthread
+
+./build/storm build/vocoder.so "${1:-10}" "${2:-20000}"
@@ -0,0 +1,76 @@
+/*
+ * Fast math approximations for the vocoder DSP
+ *
+ * Polynomial and bit-trick approximations, branch-free so that loops over
+ * bands vectorize (NEON on the Move with -Ofast). They replace libm where
+ * coefficients are recomputed while audio runs: envelope math at control
+ * rate and band frequencies under audio-rate modulation. Parameter-change
+ * code keeps using libm.
+ *
+ * Error bounds, checked by `scripts/bench.sh fastmath` against libm:
+ *   fast_sqrt  0.2% relative                      x > 0
+ *   fast_log2  2e-4 absolute (0.001 dB)           x > 0, normal
+ *   fast_exp2  2e-4 relative                      clamped to +-126
+ *   fast_sin   7.2e-7 absolute, 3.5e-6 relative   |x| <= pi
+ *              near 0; reduction adds ~6e-8 * |x|
+ *   fast_tan   4e-6 relative                      0 <= x <= 0.45 pi
+ */
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <math.h>
+#include <stdint.h>
+
+typedef union { float f; int32_t i; } f32_bits_t;
+
+/* floorf via truncation, which vectorizes without SSE4.1 too; |x| < 2^31 */
+static inline float fast_floor(float x) {
+    float t = (float)(int32_t)x;
+    return t - (t > x ? 1.0f : 0.0f);
+}
+
+static inline float fast_sqrt(float x) {
+    f32_bits_t u = { x };
+    u.i = 0x5f3759df - (u.i >> 1);
+    float r = u.f * (1.5f - 0.5f * x * u.f * u.f);
+    return x * r;
+}
+
+static inline float fast_log2(float x) {
+    f32_bits_t u = { x };
+    float e = (float)((u.i >> 23) - 127);
+    u.i = (u.i & 0x007fffff) | 0x3f800000;
+    float m = u.f - 1.0f;
+    return e + m * (1.4360981f + m * (-0.66951521f + m * (0.31221427f + m * -0.07915037f)))
+             + 0.00020416f;
+}
+
+static inline float fast_exp2(float x) {
+    x = fminf(fmaxf(x, -126.0f), 126.0f);
+    float fl = fast_floor(x);
+    float f = x - fl;
+    f32_bits_t u;
+    u.i = ((int32_t)fl + 127) << 23;
+    return u.f * (0.99981196f + f * (0.69683858f + f * (0.22412644f + f * 0.07901994f)));
+}
+
+/* Odd degree-7 minimax sine on [-pi/2, pi/2] */
+static inline float fast_sin_poly(float x) {
+    float x2 = x * x;
+    return x * (0.99999660f + x2 * (-0.16664828f + x2 * (0.0083063254f + x2 * -0.00018363651f)));
+}
+
+static inline float fast_sin(float x) {
+    /* Reduce to [-pi, pi], then fold into [-pi/2, pi/2] by sin(x) = sin(pi - x) */
+    x -= 6.2831853f * fast_floor(x * 0.15915494f + 0.5f);
+    float a = fabsf(x);
+    return copysignf(fast_sin_poly(fminf(a, 3.1415927f - a)), x);
+}
+
+/* tan for bilinear/TPT prewarping, g = tan(pi * fc / sr) */
+static inline float fast_tan(float x) {
+    return fast_sin_poly(x) / fast_sin_poly(1.5707963f - x);
+}
+
+#endif /* FASTMATH_H */
@@ -6,16 +6,24 @@
  * (synth output from the signal chain).
  *
  * Each band uses a 2nd-order state-variable bandpass filter and a single-pole
- * envelope follower with separate attack/release coefficients.
+ * envelope follower with separate attack/release coefficients. Band centers
+ * are spaced on a selectable scale (log, Bark, ERB, mel, linear) and each
+ * band's Q follows the spacing to its neighbours.
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "audio_fx_api_v1.h"
+#include "fastmath.h"
 
 /* Audio FX API v2 - instance-based */
 #define AUDIO_FX_API_VERSION_2 2
@@ -34,6 +42,51 @@ typedef audio_fx_api_v2_t* (*audio_fx_init_v2_fn)(const host_api_v1_t *host);
 
 #define SAMPLE_RATE 44100
 #define MAX_BANDS 32
+#define MAX_BLOCK 128            /* frames per internal processing chunk */
+#define DELAY_RING_SIZE 4096     /* delay line length, power of two */
+#define ALIGN_MAX_MS 50.0f       /* modulator/carrier alignment range */
+#define ALIGN_HOP 32             /* samples per alignment envelope point */
+#define ALIGN_HIST 2048          /* envelope points per estimate (~1.5 s) */
+#define ALIGN_MAX_LAG 70         /* ALIGN_MAX_MS in envelope points */
+#define ALIGN_MIN_CORR 0.3f      /* weakest correlation accepted */
+#define WORKER_PERIOD_MS 20      /* background thread poll interval */
+#define CURVE_POINTS 5           /* user gain curve points across the bands */
+#define PRESENCE_HZ 3000.0f      /* center of the presence boost */
+#define LAYOUT_CACHE_SIZE 20
+#define ADAPT_BINS 128           /* learned spectrum bins, log spaced */
+#define ADAPT_LO_HZ 80.0f        /* learned spectrum range (the freq knob limits) */
+#define ADAPT_HI_HZ 12000.0f
+#define ADAPT_HOP 8              /* chunks per envelope snapshot (~23 ms) */
+#define ADAPT_RING 16            /* snapshots queued for the worker */
+#define ADAPT_DECAY 0.998f       /* per voiced snapshot (~12 s memory) */
+#define ADAPT_UPDATE 128         /* voiced snapshots between placements (~3 s) */
+#define ADAPT_FLOOR 0.3f         /* share of the placement that stays even */
+#define ADAPT_MIN_POWER 1e-6f    /* quieter snapshots count as silence */
+#define ADAPT_MIN_RATIO 1.03f    /* closest two adaptive centers may sit */
+#define ADAPT_MOVE 0.02f         /* smallest center move (log) worth a swap */
+#define ADAPT_GLIDE 32           /* chunks to glide to a new layout (~93 ms) */
+#define PITCH_DECIM 4            /* modulator decimation for pitch tracking */
+#define PITCH_SR (SAMPLE_RATE / PITCH_DECIM)
+#define PITCH_WIN 256            /* decimated samples per estimate (~23 ms) */
+#define PITCH_MIN_HZ 60.0f
+#define PITCH_MAX_HZ 1000.0f
+#define PITCH_MIN_LAG 11         /* PITCH_SR / PITCH_MAX_HZ */
+#define PITCH_MAX_LAG 184        /* PITCH_SR / PITCH_MIN_HZ */
+#define PITCH_RING 512           /* decimated history, power of two */
+#define PITCH_HOP_CHUNKS 8       /* chunks per estimate; lag work is spread over them */
+#define PITCH_THRESH 0.15f       /* YIN aperiodicity threshold for a voiced frame */
+#define PITCH_MIN_POWER 1e-6f    /* mean square below this is silence */
+#define PITCH_ID_LEN 32          /* modulation target / param name length */
+#define CC_MAX_GROUPS 8          /* band groups sent as MIDI CCs */
+#define CC_FLOOR_DB -60.0f       /* group level sent as CC value 0 */
+#define SNAP_MAGIC 0x504e5356u   /* "VSNP", little-endian */
+#define SNAP_VERSION 4
+#define SNAP_HEADER 12           /* magic, version, bands, state JSON length */
+#define SNAP_STATE_MAX 2048      /* longest state JSON carried in a snapshot */
+#define SNAP_MAX_BYTES 32768     /* decoded snapshot buffer */
+#define ENV_MAX_SHIFT 6          /* slowest envelope update: every 64 samples */
+#define ENV_BASE_SHIFT 5         /* slowest update before the env_rate bias */
+#define ENV_PIVOT_HZ 1000.0f     /* band whose time constants equal the knobs */
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -54,270 +107,2937 @@ static inline float svf_bandpass(svf_state_t *s, float input, float f, float q)
     return s->band;
 }
 
+/* ── Quadrature pair from a narrowband signal ────────────────────────── */
+
+/*
+ * For x = A cos(wn), x[n-1] and (x[n] - x[n-2]) / (2 sin wc) are in
+ * quadrature with equal amplitude at the band center wc, so their squared
+ * sum is A^2 with no ripple at 2*fc. The error away from wc is sin w / sin wc,
+ * small inside the band. Delays the envelope by one sample.
+ */
+typedef struct {
+    float z1;
+    float z2;
+} quad_state_t;
+
+/* Quadrature scale for an SVF coefficient: f = 2 sin(wc/2), so
+ * sin wc = f * sqrt(1 - f^2/4) and k = 1 / (2 sin wc) */
+static inline float quad_k(float f) {
+    return 0.5f / (f * sqrtf(fmaxf(1.0f - 0.25f * f * f, 1e-6f)));
+}
+
+static inline float quad_power(quad_state_t *s, float input, float k) {
+    float i = s->z1;
+    float q = (input - s->z2) * k;
+    s->z2 = s->z1;
+    s->z1 = input;
+    return i * i + q * q;
+}
+
+/* Parse up to `max` comma-separated floats; returns the count read */
+static int parse_float_list(const char *s, float *out, int max) {
+    int count = 0;
+    while (*s && count < max) {
+        char *end;
+        float x = strtof(s, &end);
+        if (end == s) break;
+        out[count++] = x;
+        s = end;
+        while (*s == ',' || *s == ' ') s++;
+    }
+    return count;
+}
+
+/* Simple JSON string extraction (no escapes) */
+static int json_get_string(const char *json, const char *key, char *out, int out_len) {
+    char search[64];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+    const char *p = strstr(json, search);
+    if (!p) return -1;
+    p += strlen(search);
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p++ != '"') return -1;
+    int len = 0;
+    while (*p && *p != '"' && len < out_len - 1) out[len++] = *p++;
+    out[len] = '\0';
+    return 0;
+}
+
+/* Copy a module or parameter name, keeping only [A-Za-z0-9_.-] so it is
+ * safe to embed in the state JSON */
+static void copy_ident(char *dst, const char *src, int dst_len) {
+    int len = 0;
+    for (; *src && len < dst_len - 1; src++) {
+        char c = *src;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '_' || c == '.' || c == '-')
+            dst[len++] = c;
+    }
+    dst[len] = '\0';
+}
+
+/* Clamp helpers */
+static inline float clampf(float x, float lo, float hi) {
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+
+static inline int clampi(int x, int lo, int hi) {
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+
 /* ── Envelope follower (single-pole, separate attack/release) ──────── */
 
+/* Detector types */
+enum {
+    DET_PEAK = 0,  /* peak-held magnitude, smoothed linearly */
+    DET_RMS,       /* mean square, smoothed, square-rooted */
+    DET_LOG,       /* peak magnitude smoothed in log2 (dB) domain */
+    DET_COUNT
+};
+
+static const char *const g_detector_names[DET_COUNT] = {
+    "Peak", "RMS", "Log"
+};
+
+/* Band analysis modes */
+enum {
+    ANALYSIS_REAL = 0,  /* rectify the bandpass output */
+    ANALYSIS_QUAD,      /* magnitude of a quadrature pair */
+    ANALYSIS_COUNT
+};
+
+static const char *const g_analysis_names[ANALYSIS_COUNT] = {
+    "Real", "Quad"
+};
+
+static const char *const g_off_on_names[2] = { "Off", "On" };
+
+/* Stereo handling */
+enum {
+    STEREO_DUAL = 0,  /* independent L/R analysis and carrier banks */
+    STEREO_SPREAD,    /* one mono bank, bands panned across the field */
+    STEREO_MS,        /* full mid bank, grouped side bank */
+    STEREO_COUNT
+};
+
+static const char *const g_stereo_names[STEREO_COUNT] = {
+    "Dual", "Spread", "M/S"
+};
+
+/* M/S side bank size: one side band per 2, 4 or 8 mid bands */
+enum {
+    SIDE_HALF = 0,
+    SIDE_QUARTER,
+    SIDE_EIGHTH,
+    SIDE_COUNT
+};
+
+static const char *const g_side_names[SIDE_COUNT] = {
+    "1/2", "1/4", "1/8"
+};
+
+/* Band pan patterns for spread mode */
+enum {
+    PAN_ALTERNATE = 0,  /* L, R, L, R ... */
+    PAN_SPIRAL,         /* C, R, C, L ... rotating around the field */
+    PAN_RANDOM,         /* fixed pseudo-random positions */
+    PAN_COUNT
+};
+
+static const char *const g_pan_names[PAN_COUNT] = {
+    "Alternate", "Spiral", "Random"
+};
+
+#define ENV_LOG_FLOOR -20.0f  /* log2 amplitude, about -120 dB */
+#define WHITEN_REF 0.25f      /* carrier band RMS that whitening normalizes to */
+#define WHITEN_MAX_LOG2 5.0f  /* whitening boost limit, log2 (about 30 dB) */
+#define AGC_GATE_DB -70.0f    /* AGC holds its gain below this input level */
+#define AGC_MIN_DB -20.0f     /* most the AGC will attenuate */
+#define DB_TO_LOG2 0.16609640f /* log2(10) / 20 */
+#define NF_SUBWIN 64          /* chunks per noise-floor sub-window (~186 ms) */
+#define NF_WINDOWS 8          /* sub-windows in the minimum search (~1.5 s) */
+#define NF_BIAS 1.5f          /* minimum-to-mean correction for the floor */
+
+/* The band's instantaneous power is accumulated every sample (peak or sum)
+ * and the smoother runs once per band update interval (see recalc_bands). */
 typedef struct {
-    float level;
+    float level;  /* smoothed envelope, in the detector's domain */
+    float acc;    /* peak or sum of squares since last update */
 } env_state_t;
 
-static inline float env_follow(env_state_t *e, float input, float att, float rel) {
-    float rect = fabsf(input);
-    float coeff = (rect > e->level) ? att : rel;
-    e->level += coeff * (rect - e->level);
+static inline void env_detect(env_state_t *e, float p, int sum) {
+    e->acc = sum ? e->acc + p : fmaxf(e->acc, p);
+}
+
+static inline float env_update_peak(env_state_t *e, float att, float rel) {
+    float x = fast_sqrt(e->acc);
+    float coeff = (x > e->level) ? att : rel;
+    e->level += coeff * (x - e->level);
+    e->acc = 0.0f;
     return e->level;
 }
 
-/* ── Vocoder instance ────────────────────────────────────────────────── */
+/* Mean square of a real sine is A^2/2, so real analysis passes gain 2 to
+ * match the peak detector; quadrature power is already A^2. */
+static inline float env_update_rms(env_state_t *e, float att, float rel, float inv_len,
+                                   float gain) {
+    float x = e->acc * inv_len;
+    float coeff = (x > e->level) ? att : rel;
+    e->level += coeff * (x - e->level);
+    e->acc = 0.0f;
+    return fast_sqrt(gain * e->level);
+}
+
+/* Carrier whitening gain (WHITEN_REF / rms)^amount from the band's
+ * smoothed mean square, computed in log2 and capped at +30 dB */
+static inline float whiten_gain(const env_state_t *e, float amount) {
+    float g = amount * (fast_log2(WHITEN_REF) - 0.5f * fast_log2(e->level + 1e-12f));
+    return fast_exp2(fminf(g, WHITEN_MAX_LOG2));
+}
+
+/* Carrier whitening: smooth the band's mean square and return its gain */
+static inline float whiten_update(env_state_t *e, float att, float rel, float inv_len,
+                                  float amount) {
+    float x = e->acc * inv_len;
+    float coeff = (x > e->level) ? att : rel;
+    e->level += coeff * (x - e->level);
+    e->acc = 0.0f;
+    return whiten_gain(e, amount);
+}
+
+static inline float env_update_log(env_state_t *e, float att, float rel) {
+    float x = 0.5f * fast_log2(e->acc + 1e-12f);
+    float coeff = (x > e->level) ? att : rel;
+    e->level += coeff * (x - e->level);
+    e->acc = 0.0f;
+    return fast_exp2(e->level);
+}
+
+/* ── Band layouts ────────────────────────────────────────────────────── */
+
+/* Frequency scales for band placement */
+enum {
+    SCALE_LOG = 0,
+    SCALE_BARK,
+    SCALE_ERB,
+    SCALE_MEL,
+    SCALE_LINEAR,
+    SCALE_ADAPTIVE,  /* learned from the modulator, log until then */
+    SCALE_COUNT
+};
+
+static const char *const g_scale_names[SCALE_COUNT] = {
+    "Log", "Bark", "ERB", "Mel", "Linear", "Adaptive"
+};
+
+/* Per-band coefficients for one (scale, bands, range) combination */
+typedef struct {
+    int    valid;
+    int    scale;
+    int    bands;
+    float  freq_low;
+    float  freq_high;
+    float  fc[MAX_BANDS];    /* center frequency, Hz */
+    float  f[MAX_BANDS];     /* SVF frequency coeff */
+    float  q[MAX_BANDS];     /* SVF reciprocal-Q */
+    float  norm[MAX_BANDS];  /* level compensation for the band's Q */
+} band_layout_t;
+
+/* Band envelopes handed from the audio thread to the adaptive layout learner */
+typedef struct {
+    int    bands;
+    float  freq_low;
+    float  freq_high;
+    float  fc[MAX_BANDS];
+    float  power[MAX_BANDS];  /* detector amplitude squared */
+} adapt_snapshot_t;
+
+/* ── Processing engines ──────────────────────────────────────────────── */
+
+/*
+ * Every engine declares the delay its wet path adds relative to the input.
+ * The dry path in 'mix' is delayed by the same amount (plus any alignment
+ * delay on the carrier) so wet/dry blends stay phase-coherent. The ring
+ * that does this is sized for the worst case, DELAY_RING_SIZE - 1 samples.
+ */
+typedef struct {
+    const char *name;
+    int latency;  /* samples */
+} voc_engine_t;
+
+enum {
+    ENGINE_SVF = 0,  /* per-sample state-variable filter bank */
+    ENGINE_COUNT
+};
+
+static const voc_engine_t g_engines[ENGINE_COUNT] = {
+    { "SVF", 0 },
+};
+
+/* ── Quality tiers and CPU cost ─────────────────────────────────────── */
+
+/* Envelope update rate, as a bias on each band's update interval */
+enum {
+    ENV_RATE_FINE = 0,  /* twice as often */
+    ENV_RATE_NORMAL,
+    ENV_RATE_COARSE,    /* half as often */
+    ENV_RATE_COUNT
+};
+
+static const char *const g_env_rate_names[ENV_RATE_COUNT] = {
+    "Fine", "Normal", "Coarse"
+};
+
+/*
+ * A tier sets the settings that dominate CPU together. The SVF bank is a
+ * fixed two-pole design, so there is no filter order to pick; a tier picks
+ * the engine, band count, analysis, envelope rate and stereo handling.
+ * Changing any of those on its own moves the instance to Custom.
+ */
+enum {
+    QUALITY_CUSTOM = 0,
+    QUALITY_ECO,
+    QUALITY_STANDARD,
+    QUALITY_HIGH,
+    QUALITY_ULTRA,
+    QUALITY_COUNT
+};
+
+static const char *const g_quality_names[QUALITY_COUNT] = {
+    "Custom", "Eco", "Standard", "High", "Ultra"
+};
+
+typedef struct {
+    int engine;
+    int bands;
+    int analysis;
+    int env_rate;
+    int stereo;
+} quality_tier_t;
+
+static const quality_tier_t g_quality_tiers[QUALITY_COUNT] = {
+    { ENGINE_SVF,  0, ANALYSIS_REAL, ENV_RATE_NORMAL, STEREO_DUAL   },  /* Custom: not applied */
+    { ENGINE_SVF,  8, ANALYSIS_REAL, ENV_RATE_COARSE, STEREO_SPREAD },
+    { ENGINE_SVF, 16, ANALYSIS_REAL, ENV_RATE_NORMAL, STEREO_DUAL   },
+    { ENGINE_SVF, 24, ANALYSIS_QUAD, ENV_RATE_NORMAL, STEREO_DUAL   },
+    { ENGINE_SVF, 32, ANALYSIS_QUAD, ENV_RATE_FINE,   STEREO_DUAL   },
+};
+
+/*
+ * Cost model in work units per sample, one unit being roughly one SVF
+ * bandpass tick. Weights are a non-negative least-squares fit to block
+ * times from the scripts/bench.c signals over 388 settings (bands x
+ * stereo x analysis x detector x whitening x envelope rate, gated and
+ * open, plus pitch/air/formant/side), each timed interleaved against a
+ * Standard reference on the x86 build host (-Ofast): rms error 5.6%,
+ * tiers within 13%. There one unit is ~0.54 ns; the starting scale
+ * assumes a Cortex-A72 ~4x slower and is recalibrated while running.
+ */
+#define COST_DETECT 2.5f         /* SVF plus detector accumulate, per band per channel */
+#define COST_QUAD 0.7f           /* quadrature power on top of the SVF */
+#define COST_WHITEN 0.4f         /* carrier power accumulate */
+#define COST_WHITEN_UPDATE 20.0f /* whitening gain, per envelope update */
+#define COST_BASE 35.0f          /* pre-pass, delays and mix, per frame */
+#define COST_PITCH 21.6f         /* decimation plus amortized YIN lags, per frame */
+#define COST_NS_PER_UNIT 2.2f    /* starting scale before calibration */
+#define COST_CAL_RATE 0.02f      /* calibration EMA rate, per block */
+#define COST_PEAK_DECAY 0.999f   /* block peak decay, per block */
+
+/* Per band, per envelope update: smoother, gate and gain */
+static const float g_env_update_cost[DET_COUNT] = { 9.7f, 8.5f, 23.5f };
+
+/* Carrier SVF, envelope multiply and pan, per active band per channel.
+ * The mono banks vectorize better than the interleaved Dual pair */
+static const float g_car_cost[STEREO_COUNT] = { 1.3f, 0.83f, 0.73f };
+
+/* ── CPU budget coordinator ─────────────────────────────────────────── */
+
+/*
+ * All instances in the process share a budget, a percentage of the block
+ * deadline, set by cpu_budget in the module.json defaults or with
+ * set_param on any instance. It is not part of an instance's state, so
+ * presets and snapshots leave it alone. Each instance owns a slot where
+ * it publishes its measured block time and priority. After every block
+ * it sums the slots and, when the total is over budget, the
+ * lowest-priority instance (then the most expensive, then the highest
+ * slot) that can still degrade steps one level down. Once the total falls
+ * well under budget, the highest-priority degraded instance steps back
+ * up. Every instance computes the same choice from the shared slots, so
+ * only one acts; a shared timestamp then holds every instance for
+ * COORD_HOLD_MS while the measured costs settle.
+ * No locks are taken: slots and the timestamp are claimed with a
+ * compare-and-swap.
+ */
+#define COORD_SLOTS 16
+#define COORD_HOLD_MS 400       /* between level changes, across all instances */
+#define COORD_RECOVER 0.6f      /* step back up below this share of budget */
+#define COORD_BUDGET_DEFAULT 50 /* percent of the block deadline */
+
+/* Degrade levels, each including the ones before */
+enum {
+    CPU_LEVEL_FULL = 0,
+    CPU_LEVEL_COARSE,   /* envelope updates at half rate */
+    CPU_LEVEL_REAL,     /* real analysis in place of quadrature */
+    CPU_LEVEL_MONO,     /* one modulator analysis shared by both channels */
+    CPU_LEVEL_COUNT
+};
+
+static const char *const g_cpu_level_names[CPU_LEVEL_COUNT] = {
+    "Full", "Coarse Env", "Real", "Mono Mod"
+};
+
+enum {
+    PRIORITY_LOW = 0,
+    PRIORITY_NORMAL,
+    PRIORITY_HIGH,
+    PRIORITY_COUNT
+};
+
+static const char *const g_priority_names[PRIORITY_COUNT] = {
+    "Low", "Normal", "High"
+};
+
+typedef struct {
+    atomic_int used;
+    atomic_int cost_ns;    /* smoothed block time */
+    atomic_int priority;   /* PRIORITY_* */
+    atomic_int level;      /* CPU_LEVEL_* */
+    atomic_int max_level;  /* deepest level that saves anything */
+} coord_slot_t;
+
+static coord_slot_t g_coord_slots[COORD_SLOTS];
+static atomic_int g_coord_budget_pct = COORD_BUDGET_DEFAULT;
+static atomic_int g_coord_configured;  /* module defaults read */
+static atomic_uint g_coord_next_ms;  /* no level changes before this time */
+
+/* Claim a coordinator slot; -1 leaves the instance uncoordinated */
+static int coord_register(void) {
+    for (int i = 0; i < COORD_SLOTS; i++) {
+        int expected = 0;
+        coord_slot_t *s = &g_coord_slots[i];
+        if (atomic_compare_exchange_strong(&s->used, &expected, 1)) {
+            atomic_store(&s->cost_ns, 0);
+            atomic_store(&s->priority, PRIORITY_NORMAL);
+            atomic_store(&s->level, CPU_LEVEL_FULL);
+            atomic_store(&s->max_level, CPU_LEVEL_FULL);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void coord_deregister(int slot) {
+    if (slot < 0) return;
+    atomic_store(&g_coord_slots[slot].cost_ns, 0);
+    atomic_store(&g_coord_slots[slot].used, 0);
+}
+
+/* ── Modulator/carrier alignment ─────────────────────────────────────── */
+
+/* Automatic alignment estimate status */
+enum {
+    ALIGN_IDLE = 0,
+    ALIGN_LISTEN,   /* audio thread is recording envelopes */
+    ALIGN_DONE,     /* estimate applied */
+    ALIGN_FAILED,   /* signals were not correlated enough */
+    ALIGN_STATUS_COUNT
+};
+
+static const char *const g_align_status_names[ALIGN_STATUS_COUNT] = {
+    "Idle", "Listening", "Done", "Failed"
+};
+
+/* Control-thread requests, taken by the audio thread at the next chunk */
+enum {
+    ALIGN_REQ_NONE = 0,
+    ALIGN_REQ_START,
+    ALIGN_REQ_STOP
+};
+
+/* ── Envelope to MIDI CC ──────────────────────────────────────────── */
+
+/* Where grouped band levels are sent */
+enum {
+    CC_OUT_OFF = 0,
+    CC_OUT_INTERNAL,  /* midi_send_internal: Move's own instruments */
+    CC_OUT_EXTERNAL,  /* midi_send_external: USB-MIDI to hardware */
+    CC_OUT_BOTH,
+    CC_OUT_COUNT
+};
+
+static const char *const g_cc_out_names[CC_OUT_COUNT] = {
+    "Off", "Internal", "External", "Both"
+};
+
+/* ── Modulator conditioning (DC block / high-pass / pre-emphasis) ─── */
+
+typedef struct {
+    float x1;  /* previous input */
+    float y1;  /* previous high-pass output */
+} precond_state_t;
+
+/* Air band: the modulator above High Freq, where sibilants live, mixed
+ * into the output directly or as the envelope of high-passed noise */
+enum {
+    AIR_DIRECT = 0,
+    AIR_NOISE,
+    AIR_MODE_COUNT
+};
+
+static const char *const g_air_mode_names[AIR_MODE_COUNT] = {
+    "Direct", "Noise"
+};
+
+#define AIR_GAIN 0.5f           /* output level at Air = 1, before Out Gain */
+#define AIR_NOISE_GAIN 1.5f     /* high-passed noise times envelope ~ input RMS */
+#define AIR_ATTACK_MS 1.0f
+#define AIR_RELEASE_MS 30.0f
+#define COST_AIR 9.0f           /* high-pass, follower and delay, per frame */
+
+/* Formant shift / band sweep: the carrier bank is retuned every
+ * FORMANT_STEP samples while either is active */
+#define FORMANT_STEP 8
+#define FORMANT_GLIDE_MS 20.0f   /* smoothing of Formant changes */
+#define FORMANT_MAX_W 0.52359878f /* pi/6: keeps the SVF coefficient <= 1 */
+#define COST_FORMANT 1.0f        /* per band per frame, amortized over the step */
+
+/* ── Vocoder instance ────────────────────────────────────────────────── */
+
+typedef struct {
+    /* Parameters */
+    int    bands;         /* 8, 16, 24, or 32 */
+    float  freq_low;      /* Hz */
+    float  freq_high;     /* Hz */
+    float  attack_ms;     /* ms */
+    float  release_ms;    /* ms */
+    float  mod_gain;      /* 0..6 modulator input gain */
+    float  output_gain;   /* 0..6 output gain */
+    float  mix;           /* 0..1 wet/dry */
+    float  carrier_mix;   /* 0..1 noise for unvoiced */
+    int    scale;         /* SCALE_* band spacing */
+    float  env_scale;     /* 0.25..4 multiplier on per-band time constants */
+    int    detector;      /* DET_* envelope detector */
+    int    analysis;      /* ANALYSIS_* band magnitude */
+    int    dc_block;      /* 0/1 remove DC from modulator */
+    float  mod_hpf;       /* 0..300 Hz modulator high-pass (0 = off) */
+    float  pre_emph;      /* 0..0.95 first-order pre-emphasis */
+    float  whiten;        /* 0..1 carrier spectral whitening amount */
+    int    agc;           /* 0/1 modulator automatic gain control */
+    float  agc_target;    /* -40..-6 dBFS target modulator level */
+    float  agc_max;       /* 0..40 dB maximum AGC boost */
+    float  agc_attack_ms; /* 10..1000 ms gain reduction time */
+    float  agc_release_ms;/* 50..5000 ms gain recovery time */
+    float  gate;          /* 0..1 spectral gate / noise subtraction amount */
+    float  align_ms;      /* -50..50 ms: >0 delays carrier, <0 delays modulator */
+    float  tilt;          /* -6..6 dB/octave around ENV_PIVOT_HZ */
+    float  presence;      /* 0..12 dB bell at PRESENCE_HZ */
+    float  curve[CURVE_POINTS]; /* -24..24 dB, spread evenly across the bands */
+    int    stereo;        /* STEREO_* */
+    int    pan_mode;      /* PAN_* band pan pattern in spread mode */
+    float  width;         /* 0..1 spread width */
+    int    side_bands;    /* SIDE_* side bank size in M/S mode */
+    float  formant;       /* -12..12 semitones, carrier bank against modulator */
+    float  sweep_rate;    /* 0..20 Hz band sweep LFO */
+    float  sweep_depth;   /* 0..12 semitones (0 = off) */
+    int    quality;       /* QUALITY_* tier, Custom once a tier setting is changed */
+    int    env_rate;      /* ENV_RATE_* envelope update rate */
+    int    priority;      /* PRIORITY_* when the shared CPU budget is short */
+    float  air;           /* 0..1 air band level (0 = off) */
+    int    air_mode;      /* AIR_* */
+
+    /* Derived per-band coefficients */
+    float  band_fc[MAX_BANDS];   /* center frequency, Hz */
+    float  band_f[MAX_BANDS];    /* SVF frequency coeff */
+    float  band_q[MAX_BANDS];    /* SVF reciprocal-Q */
+    float  band_norm[MAX_BANDS]; /* per-band level compensation */
+    float  band_gain[MAX_BANDS]; /* band_norm * spectral shaping, used on the envelope */
+    float  band_quad_k[MAX_BANDS]; /* 1 / (2 sin wc) for the quadrature pair */
+    float  pan_l[MAX_BANDS];     /* spread-mode band pan gains */
+    float  pan_r[MAX_BANDS];
+    int    side_shift;           /* M/S: 1 << side_shift mid bands per side band */
+    float  side_f[MAX_BANDS];    /* side band SVF frequency coeff */
+    float  side_q[MAX_BANDS];    /* side band SVF reciprocal-Q */
+    float  side_comp[MAX_BANDS]; /* group envelope sum -> side band level */
+    float  side_fc[MAX_BANDS];   /* side band center, Hz */
+
+    /* Shifted carrier coefficients, used instead of band_f/side_f while a
+     * formant shift or sweep is active */
+    float  car_f[MAX_BANDS];
+    float  car_side_f[MAX_BANDS];
+    float  formant_cur;          /* smoothed shift, semitones */
+    float  formant_coeff;        /* smoothing per FORMANT_STEP */
+    float  sweep_phase;          /* 0..1 */
+    float  band_att[MAX_BANDS];  /* envelope attack, per update interval */
+    float  band_rel[MAX_BANDS];  /* envelope release, per update interval */
+    int    band_shift[MAX_BANDS]; /* update interval = 1 << shift samples */
+    float  band_inv_len[MAX_BANDS]; /* 1 / update interval */
+    int    rate_start[ENV_MAX_SHIFT + 1]; /* first band updated at each shift */
+
+    /* Filter states (modulator + carrier, stereo) */
+    svf_state_t mod_svf_l[MAX_BANDS];
+    svf_state_t mod_svf_r[MAX_BANDS];
+    svf_state_t car_svf_l[MAX_BANDS];
+    svf_state_t car_svf_r[MAX_BANDS];
+    quad_state_t mod_quad_l[MAX_BANDS];
+    quad_state_t mod_quad_r[MAX_BANDS];
+    env_state_t mod_env_l[MAX_BANDS];
+    env_state_t mod_env_r[MAX_BANDS];
+    float  env_amp_l[MAX_BANDS];   /* detector output (linear amplitude) */
+    float  env_amp_r[MAX_BANDS];
+    float  env_out_l[MAX_BANDS];   /* gated envelope * gains, held between updates */
+    float  env_out_r[MAX_BANDS];
+    env_state_t car_env_l[MAX_BANDS];  /* carrier band power, for whitening */
+    env_state_t car_env_r[MAX_BANDS];
+    svf_state_t side_svf[MAX_BANDS];   /* M/S side bank */
+    float  side_env[MAX_BANDS];    /* grouped mid envelopes, held with env_out */
+    uint32_t env_phase;            /* sample counter driving envelope updates */
+
+    /* Modulator conditioning */
+    float  hp_coeff;               /* one-pole high-pass pole (1 = bypass) */
+    precond_state_t mod_pre_l;
+    precond_state_t mod_pre_r;
+
+    /* Air band, filtered in the pre-pass */
+    float  air_coeff;              /* one-pole high-pass pole at freq_high */
+    float  air_att;                /* noise-mode follower, per sample */
+    float  air_rel;
+    precond_state_t air_pre_l;
+    precond_state_t air_pre_r;
+    precond_state_t air_noise;
+    float  air_env_l;
+    float  air_env_r;
+
+    /* Modulator level metering and AGC (block rate) */
+    float  agc_att_coeff;          /* per MAX_BLOCK chunk */
+    float  agc_rel_coeff;
+    float  agc_gain_db;            /* smoothed AGC gain */
+    float  agc_gain_lin;           /* linear gain applied at end of last chunk */
+    float  input_level_db;         /* conditioned modulator RMS, read by get_param */
+
+    /* Minimum-statistics noise floor per band (chunk rate) and the gate
+     * subtraction derived from it */
+    float  nf_min_l[MAX_BANDS];            /* minimum in current sub-window */
+    float  nf_min_r[MAX_BANDS];
+    float  nf_hist_l[NF_WINDOWS][MAX_BANDS]; /* minima of past sub-windows */
+    float  nf_hist_r[NF_WINDOWS][MAX_BANDS];
+    float  gate_sub_l[MAX_BANDS];          /* gate * 2 * floor */
+    float  gate_sub_r[MAX_BANDS];
+    int    nf_count;                       /* chunks into current sub-window */
+    int    nf_slot;                        /* next history slot */
+
+    /* Carrier bands skipped because their gated envelope is closed */
+    uint8_t band_active[MAX_BANDS];
+    int    active_list[MAX_BANDS];
+    int    active_count;
+
+    /* Delay lines: dry latency compensation and modulator/carrier alignment.
+     * All rings advance together from delay_pos. */
+    int    engine;                 /* ENGINE_* in use */
+    int    latency;                /* wet-path latency, samples */
+    int    mod_delay;              /* alignment delay on the modulator, samples */
+    int    car_delay;              /* alignment delay on the carrier, samples */
+    int    air_delay;              /* air path: wet latency plus modulator delay */
+    float  dry_ring_l[DELAY_RING_SIZE];
+    float  dry_ring_r[DELAY_RING_SIZE];
+    float  mod_ring_l[DELAY_RING_SIZE];
+    float  mod_ring_r[DELAY_RING_SIZE];
+    float  car_ring_l[DELAY_RING_SIZE];
+    float  car_ring_r[DELAY_RING_SIZE];
+    int    car_ring_ms;            /* car rings hold mid/side, not L/R */
+    float  air_ring_l[DELAY_RING_SIZE];
+    float  air_ring_r[DELAY_RING_SIZE];
+    uint32_t delay_pos;
+
+    /* Automatic alignment: the audio thread records hop-rate envelopes of
+     * modulator and carrier, the worker thread cross-correlates them */
+    atomic_int align_status;       /* ALIGN_*, written by the audio thread */
+    atomic_int align_request;      /* control -> audio: ALIGN_REQ_* */
+    atomic_int align_shot_ready;   /* audio -> worker: align_env_* complete */
+    atomic_int align_result_ready; /* worker -> audio: align_result_* valid */
+    int    align_gen;              /* bumped by every request, drops stale results */
+    int    align_shot_gen;
+    int    align_result_gen;
+    int    align_result_ok;
+    float  align_result_ms;
+    float  align_result_corr;
+    float  align_corr;             /* peak correlation of last estimate */
+    int    align_count;            /* envelope points recorded */
+    float  align_acc_mod;
+    float  align_acc_car;
+    int    align_hop_pos;
+    float  align_env_mod[ALIGN_HIST];
+    float  align_env_car[ALIGN_HIST];
+
+    /* Background worker for non-realtime analysis, started on demand */
+    pthread_t  worker;
+    int        worker_started;
+    atomic_int worker_run;
+
+    /* Adaptive layout: the audio thread queues envelope snapshots, the
+     * worker learns a long-term spectrum from them and places bands on
+     * it, and the audio thread glides to each new placement */
+    adapt_snapshot_t adapt_ring[ADAPT_RING];
+    atomic_uint adapt_write;       /* snapshots queued (audio thread) */
+    atomic_uint adapt_read;        /* snapshots consumed (worker) */
+    int    adapt_hop_pos;          /* chunks since the last snapshot */
+    float  adapt_spec[ADAPT_BINS]; /* learned spectrum shape (worker) */
+    int    adapt_voiced;           /* voiced snapshots since the last placement */
+    int    adapt_learned;          /* voiced snapshots since reset */
+    int    adapt_bands;            /* layout of the latest snapshot (worker) */
+    float  adapt_lo;
+    float  adapt_hi;
+    atomic_int adapt_reset;        /* control -> worker: forget the spectrum */
+    band_layout_t adapt_pending;   /* worker -> audio, valid while adapt_ready */
+    atomic_int adapt_ready;
+    band_layout_t adapt_layout;    /* placement in use */
+    int    adapt_glide;            /* chunks left gliding band_f/band_q */
+
+    /* Pitch tracker: YIN on a decimated mono modulator, one estimate per
+     * PITCH_HOP_CHUNKS chunks with the lag sums spread across them */
+    int    pitch_track;            /* 0/1 */
+    float  pitch_depth;            /* 0..1 modulation depth */
+    char   pitch_target[PITCH_ID_LEN]; /* module receiving the pitch modulation */
+    char   pitch_param[PITCH_ID_LEN];  /* its parameter */
+    char   pitch_emit_target[PITCH_ID_LEN]; /* copies the audio thread emits to */
+    char   pitch_emit_param[PITCH_ID_LEN];
+    char   mod_source[PITCH_ID_LEN];   /* modulation source id for this instance */
+    atomic_int pitch_retarget;     /* control -> audio: clear source, take new names */
+    int    pitch_emitted;          /* source has a live contribution */
+    float  pitch_lp1;              /* decimation low-pass states */
+    float  pitch_lp2;
+    int    pitch_dec_pos;
+    float  pitch_ring[PITCH_RING];
+    uint32_t pitch_wpos;
+    float  pitch_frame[PITCH_WIN + PITCH_MAX_LAG];
+    float  pitch_diff[PITCH_MAX_LAG + 1];  /* YIN difference function */
+    float  pitch_power;            /* frame mean square */
+    int    pitch_chunk;            /* chunk within the current estimate */
+    float  pitch_hz;               /* last voiced estimate, 0 before the first */
+    float  pitch_conf;             /* 0..1, 1 - aperiodicity of the last frame */
+    float  pitch_ns;               /* measured tracker time per block, smoothed */
+
+    /* Envelope to MIDI CC: contiguous band groups, level in dB mapped to
+     * 0..127, sent at most cc_rate times a second when a value moves by
+     * cc_thresh or more */
+    int    cc_out;                 /* CC_OUT_* */
+    int    cc_groups;              /* 2..CC_MAX_GROUPS */
+    int    cc_base;                /* CC number of the lowest group, 0..120 - cc_groups */
+    int    cc_channel;             /* 1..16 */
+    float  cc_rate;                /* 5..100 sends per second */
+    int    cc_thresh;              /* 1..16 smallest change that is sent */
+    float  cc_timer;               /* chunks until the next send */
+    int    cc_first;               /* group a batch starts from, rotated on short writes */
+    int    cc_sent[CC_MAX_GROUPS]; /* last value sent per group, -1 = none */
+
+    /* DSP snapshot restore: decoded by the control thread, the filter and
+     * envelope memories are copied in by the audio thread between chunks */
+    uint8_t snap_buf[SNAP_MAX_BYTES];
+    int    snap_len;
+    int    snap_offset;            /* start of the memory section */
+    int    snap_band_count;        /* band count the memories were saved at */
+    atomic_int snap_ready;
+
+    /* Bumped on every parameter change; get_param("state") is formatted
+     * once per version */
+    atomic_uint param_version;
+    unsigned state_version;
+    int    state_len;
+    char   state_cache[SNAP_STATE_MAX];
+
+    /* CPU cost model: predicted from settings, scaled by measured time */
+    float  cost_fixed;             /* units per frame with every carrier band closed */
+    float  cost_band;              /* units per frame per open carrier band */
+    float  ns_per_unit;            /* calibrated against block times */
+    float  block_ns_avg;           /* measured block time, smoothed */
+    float  block_ns_max;           /* measured block time, decaying peak */
+
+    /* CPU budget coordinator: settings actually run after degrading */
+    int    coord_slot;             /* -1 when every slot was taken */
+    int    cpu_level;              /* CPU_LEVEL_* */
+    int    run_analysis;           /* analysis, or Real when degraded */
+    int    run_mono_mod;           /* dual mode sharing one modulator analysis */
+
+    /* Per-chunk input buffers filled by the pre-pass */
+    float  dry_buf_l[MAX_BLOCK];
+    float  dry_buf_r[MAX_BLOCK];
+    float  car_buf_l[MAX_BLOCK];
+    float  car_buf_r[MAX_BLOCK];
+    float  mod_buf_l[MAX_BLOCK];
+    float  mod_buf_r[MAX_BLOCK];
+    float  wet_buf_l[MAX_BLOCK];   /* unscaled vocoder output */
+    float  wet_buf_r[MAX_BLOCK];
+    float  air_buf_l[MAX_BLOCK];   /* air band, mixed after the wet path */
+    float  air_buf_r[MAX_BLOCK];
+
+    /* Simple noise state for unvoiced */
+    uint32_t noise_seed;
+
+    /* Serializes the audio thread and control calls. Priority-inheriting,
+     * so a control thread holding it runs at the audio thread's priority
+     * until it lets go. Initialized once with the instance and kept across
+     * pool_reset, so it stays last. */
+    pthread_mutex_t lock;
+} vocoder_instance_t;
+
+static const host_api_v1_t *g_host = NULL;
+
+/* ── Helpers ─────────────────────────────────────────────────────────── */
+
+static void voc_log(const char *msg) {
+    if (g_host && g_host->log) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), "[vocoder] %s", msg);
+        g_host->log(buf);
+    }
+}
+
+/* Simple fast white noise */
+static inline float noise_sample(uint32_t *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return (float)(int32_t)(*seed) / 2147483648.0f;
+}
+
+/* Map Hz onto a scale's warped axis and back */
+static float scale_warp(int scale, float hz) {
+    switch (scale) {
+        case SCALE_BARK:   return 26.81f * hz / (1960.0f + hz) - 0.53f;     /* Traunmueller */
+        case SCALE_ERB:    return 21.4f * log10f(1.0f + 0.00437f * hz);     /* Glasberg & Moore */
+        case SCALE_MEL:    return 2595.0f * log10f(1.0f + hz / 700.0f);
+        case SCALE_LINEAR: return hz;
+        default:           return logf(hz);
+    }
+}
+
+static float scale_unwarp(int scale, float z) {
+    switch (scale) {
+        case SCALE_BARK:   return 1960.0f * (z + 0.53f) / (26.28f - z);
+        case SCALE_ERB:    return (powf(10.0f, z / 21.4f) - 1.0f) / 0.00437f;
+        case SCALE_MEL:    return 700.0f * (powf(10.0f, z / 2595.0f) - 1.0f);
+        case SCALE_LINEAR: return z;
+        default:           return expf(z);
+    }
+}
+
+/* Fill a layout's filter coefficients from its centers, Q from neighbours */
+static void layout_coeffs(band_layout_t *L, int n, float lo, float hi) {
+    /* Reference Q of the original fixed layout, used to keep levels matched */
+    float q_ref = 1.0f + 0.5f * sqrtf((float)n);
+
+    for (int i = 0; i < n; i++) {
+        float fc = L->fc[i];
+
+        /* SVF frequency coefficient: 2 * sin(pi * fc / sr) */
+        float f = 2.0f * sinf((float)M_PI * fc / (float)SAMPLE_RATE);
+        /* Clamp to avoid instability */
+        if (f > 1.0f) f = 1.0f;
+        L->f[i] = f;
+
+        /* Band edges halfway to each neighbour; outer bands mirror inward */
+        float below, above;
+        if (n == 1) {
+            below = fc - lo;
+            above = hi - fc;
+            if (below < fc * 0.25f) below = fc * 0.25f;
+            if (above < fc * 0.25f) above = fc * 0.25f;
+        } else {
+            below = (i > 0)     ? fc - L->fc[i - 1] : L->fc[i + 1] - fc;
+            above = (i < n - 1) ? L->fc[i + 1] - fc : fc - L->fc[i - 1];
+        }
+        float bw = 0.5f * (below + above);
+        float Q = clampf(fc / bw, 0.7f, 12.0f);
+        L->q[i] = 1.0f / Q;
+
+        /* SVF bandpass peak gain is Q on both paths, so scale by (Q_ref/Q)^2 */
+        float g = q_ref / Q;
+        L->norm[i] = g * g;
+    }
+}
+
+/* Fill a layout: centers evenly spaced on the warped axis */
+static void compute_layout(band_layout_t *L, int scale, int n, float lo, float hi) {
+    float z_lo = scale_warp(scale, lo);
+    float z_hi = scale_warp(scale, hi);
+
+    for (int i = 0; i < n; i++) {
+        float t = (n > 1) ? (float)i / (float)(n - 1) : 0.5f;
+        L->fc[i] = scale_unwarp(scale, z_lo + t * (z_hi - z_lo));
+    }
+    layout_coeffs(L, n, lo, hi);
+
+    L->scale     = scale;
+    L->bands     = n;
+    L->freq_low  = lo;
+    L->freq_high = hi;
+    L->valid     = 1;
+}
+
+/* Layouts shared by all instances, filled on parameter changes. A miss
+ * warms every scale for the range, so switching scales afterwards is a
+ * table copy with no trig. Instances recalculate from their own control
+ * and audio threads, so the cache is only touched under g_layout_lock. */
+static band_layout_t g_layout_cache[LAYOUT_CACHE_SIZE];
+static int g_layout_next = 0;
+static pthread_mutex_t g_layout_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const band_layout_t *find_layout(int scale, int n, float lo, float hi) {
+    for (int i = 0; i < LAYOUT_CACHE_SIZE; i++) {
+        const band_layout_t *L = &g_layout_cache[i];
+        if (L->valid && L->scale == scale && L->bands == n &&
+            L->freq_low == lo && L->freq_high == hi)
+            return L;
+    }
+    return NULL;
+}
+
+static const band_layout_t *get_layout(int scale, int n, float lo, float hi) {
+    const band_layout_t *L = find_layout(scale, n, lo, hi);
+    if (L) return L;
+
+    for (int s = 0; s < SCALE_ADAPTIVE; s++) {
+        if (find_layout(s, n, lo, hi)) continue;
+        band_layout_t *slot = &g_layout_cache[g_layout_next];
+        g_layout_next = (g_layout_next + 1) % LAYOUT_CACHE_SIZE;
+        compute_layout(slot, s, n, lo, hi);
+    }
+    return find_layout(scale, n, lo, hi);
+}
+
+/* Copy a cached layout out, so no pointer into the cache outlives the lock */
+static void load_layout(band_layout_t *out, int scale, int n, float lo, float hi) {
+    pthread_mutex_lock(&g_layout_lock);
+    *out = *get_layout(scale, n, lo, hi);
+    pthread_mutex_unlock(&g_layout_lock);
+}
+
+/* Split the alignment setting into modulator/carrier delays and derive the
+ * total wet-path delay the dry path must match */
+static void update_delays(vocoder_instance_t *v) {
+    int d = (int)lrintf(fabsf(v->align_ms) * 0.001f * (float)SAMPLE_RATE);
+    v->car_delay = (v->align_ms > 0.0f) ? d : 0;
+    v->mod_delay = (v->align_ms < 0.0f) ? d : 0;
+    v->latency = clampi(g_engines[v->engine].latency + v->car_delay, 0, DELAY_RING_SIZE - 1);
+    v->air_delay = clampi(g_engines[v->engine].latency + v->mod_delay, 0, DELAY_RING_SIZE - 1);
+}
+
+/* Predict work units per frame from the current settings */
+static void update_cost(vocoder_instance_t *v) {
+    int n = v->bands;
+    float ch = (v->stereo == STEREO_DUAL) ? 2.0f : 1.0f;
+    float mod_ch = v->run_mono_mod ? 1.0f : ch;
+    int whiten = (v->whiten > 0.0f);
+
+    float mod = COST_DETECT;
+    if (v->run_analysis == ANALYSIS_QUAD) mod += COST_QUAD;
+
+    /* Envelope updates per frame, summed over bands */
+    float updates = 0.0f;
+    for (int b = 0; b < n; b++)
+        updates += v->band_inv_len[b];
+    float env = g_env_update_cost[v->detector];
+    if (whiten) env += COST_WHITEN_UPDATE;
+
+    v->cost_fixed = COST_BASE + mod_ch * ((float)n * mod + updates * env);
+    if (v->pitch_track) v->cost_fixed += COST_PITCH;
+    if (v->air > 0.0f) v->cost_fixed += COST_AIR;
+    if (v->formant != 0.0f || v->sweep_depth > 0.0f)
+        v->cost_fixed += (float)n * COST_FORMANT;
+    /* The M/S side bank fits as part of g_car_cost[STEREO_MS] */
+    v->cost_band = ch * (g_car_cost[v->stereo] + (whiten ? COST_WHITEN : 0.0f));
+}
+
+/* Envelope time constants and the update schedule for the current layout */
+static void update_env_timing(vocoder_instance_t *v) {
+    int n = v->bands;
+
+    /*
+     * Envelope time constants scale with 1/sqrt(fc): low bands cannot move
+     * fast anyway, so they get smoother envelopes. Each band's smoother runs
+     * every 2^shift samples, bounded by a quarter of the attack time and, for
+     * real analysis, one band period (the peak hold still sees every cycle).
+     * Quadrature magnitude has no carrier ripple, so it needs no such bound.
+     * env_rate then halves or doubles the interval.
+     */
+    int rate_bias = v->env_rate - ENV_RATE_NORMAL + (v->cpu_level >= CPU_LEVEL_COARSE);
+    for (int i = 0; i < n; i++) {
+        float k = clampf(sqrtf(ENV_PIVOT_HZ / v->band_fc[i]), 0.5f, 3.0f) * v->env_scale;
+        float att_s = v->attack_ms  * k * 0.001f * (float)SAMPLE_RATE;
+        float rel_s = v->release_ms * k * 0.001f * (float)SAMPLE_RATE;
+        if (att_s < 1.0f) att_s = 1.0f;
+        if (rel_s < 1.0f) rel_s = 1.0f;
+
+        float limit = att_s * 0.25f;
+        if (v->run_analysis == ANALYSIS_REAL)
+            limit = fminf(limit, (float)SAMPLE_RATE / v->band_fc[i]);
+        int shift = 0;
+        while (shift < ENV_BASE_SHIFT && (float)(2 << shift) <= limit) shift++;
+        shift = clampi(shift + rate_bias, 0, ENV_MAX_SHIFT);
+        /* Updates are scheduled as a suffix of bands, so keep shifts non-increasing */
+        if (i > 0 && shift > v->band_shift[i - 1]) shift = v->band_shift[i - 1];
+        v->band_shift[i] = shift;
+
+        float interval = (float)(1 << shift);
+        v->band_inv_len[i] = 1.0f / interval;
+        v->band_att[i] = 1.0f - expf(-interval / att_s);
+        v->band_rel[i] = 1.0f - expf(-interval / rel_s);
+    }
+
+    /* Samples where (phase + 1) has k trailing zeros update bands from rate_start[k] */
+    for (int k = 0; k <= ENV_MAX_SHIFT; k++) {
+        int b = 0;
+        while (b < n && v->band_shift[b] > k) b++;
+        v->rate_start[k] = b;
+    }
+}
+
+/*
+ * Derived state that depends on the degrade level. It leaves the band
+ * layout alone, so it is cheap enough for the audio thread.
+ */
+static void apply_cpu_level(vocoder_instance_t *v) {
+    v->run_analysis = (v->cpu_level >= CPU_LEVEL_REAL) ? ANALYSIS_REAL : v->analysis;
+    v->run_mono_mod = (v->cpu_level >= CPU_LEVEL_MONO && v->stereo == STEREO_DUAL);
+    update_env_timing(v);
+    update_cost(v);
+}
+
+/* Recalculate per-band coefficients from current parameters */
+static void recalc_bands(vocoder_instance_t *v) {
+    int n = v->bands;
+    band_layout_t cached;
+    const band_layout_t *L = &v->adapt_layout;
+    if (v->scale != SCALE_ADAPTIVE || !L->valid || L->bands != n ||
+        L->freq_low != v->freq_low || L->freq_high != v->freq_high) {
+        load_layout(&cached, v->scale == SCALE_ADAPTIVE ? SCALE_LOG : v->scale,
+                    n, v->freq_low, v->freq_high);
+        L = &cached;
+    }
+    v->adapt_glide = 0;
+
+    memcpy(v->band_fc,   L->fc,   sizeof(float) * n);
+    memcpy(v->band_f,    L->f,    sizeof(float) * n);
+    memcpy(v->band_q,    L->q,    sizeof(float) * n);
+    memcpy(v->band_norm, L->norm, sizeof(float) * n);
+
+    /*
+     * Spectral shaping (tilt, presence, user curve) is summed in dB and
+     * folded into the envelope gain, so it costs nothing per sample.
+     */
+    for (int i = 0; i < n; i++) {
+        float oct = log2f(v->band_fc[i] / ENV_PIVOT_HZ);
+        float db = v->tilt * oct;
+
+        float d = log2f(v->band_fc[i] / PRESENCE_HZ);
+        db += v->presence * expf(-2.0f * d * d);  /* about one octave wide */
+
+        float pos = (n > 1) ? (float)i * (float)(CURVE_POINTS - 1) / (float)(n - 1) : 0.0f;
+        int k = (int)pos;
+        if (k >= CURVE_POINTS - 1) k = CURVE_POINTS - 2;
+        float t = pos - (float)k;
+        db += v->curve[k] + t * (v->curve[k + 1] - v->curve[k]);
+
+        v->band_gain[i] = v->band_norm[i] * powf(10.0f, db / 20.0f);
+    }
+
+    /* Spread-mode pans: equal power, scaled so a centered band has unity gain */
+    uint32_t seed = 0x9e3779b9u;
+    for (int i = 0; i < n; i++) {
+        float pos;
+        switch (v->pan_mode) {
+            case PAN_SPIRAL: pos = sinf((float)i * (float)M_PI * 0.5f); break;
+            case PAN_RANDOM: pos = noise_sample(&seed); break;
+            default:         pos = (i & 1) ? 1.0f : -1.0f; break;
+        }
+        float a = (pos * v->width + 1.0f) * (float)M_PI * 0.25f;
+        v->pan_l[i] = (float)M_SQRT2 * cosf(a);
+        v->pan_r[i] = (float)M_SQRT2 * sinf(a);
+    }
+
+    /*
+     * M/S side bank: each side band spans a group of mid bands, edge to
+     * edge. Its envelope is the group's envelope sum times side_comp, which
+     * matches the group's summed output power for a flat carrier (SVF
+     * bandpass power on white input goes as Q * fc).
+     */
+    v->side_shift = v->side_bands + 1;
+    while ((n >> v->side_shift) < 2)
+        v->side_shift--;  /* one band cannot span the whole range */
+    int gs = 1 << v->side_shift;
+    for (int g = 0; g < (n >> v->side_shift); g++) {
+        int b0 = g * gs, b1 = b0 + gs - 1;
+        float lo = v->band_fc[b0] * (1.0f - 0.5f * v->band_q[b0]);
+        float hi = v->band_fc[b1] * (1.0f + 0.5f * v->band_q[b1]);
+        float fc = sqrtf(lo * hi);
+        float Q = clampf(fc / (hi - lo), 0.25f, 12.0f);
+        float f = 2.0f * sinf((float)M_PI * fc / (float)SAMPLE_RATE);
+        v->side_f[g] = (f > 1.0f) ? 1.0f : f;
+        v->side_q[g] = 1.0f / Q;
+        v->side_fc[g] = fc;
+
+        float mid_power = 0.0f;
+        for (int b = b0; b <= b1; b++)
+            mid_power += v->band_fc[b] / v->band_q[b];
+        v->side_comp[g] = sqrtf(mid_power / (Q * fc)) / (float)gs;
+    }
+
+    for (int i = 0; i < n; i++)
+        v->band_quad_k[i] = quad_k(v->band_f[i]);
+
+    apply_cpu_level(v);
+
+    v->formant_coeff = 1.0f - expf(-1000.0f * (float)FORMANT_STEP /
+                                   (FORMANT_GLIDE_MS * (float)SAMPLE_RATE));
+
+    /* Modulator high-pass: DC blocker alone sits at 10 Hz */
+    float hp_hz = v->mod_hpf;
+    if (v->dc_block && hp_hz < 10.0f) hp_hz = 10.0f;
+    v->hp_coeff = (hp_hz > 0.0f) ? expf(-2.0f * (float)M_PI * hp_hz / (float)SAMPLE_RATE) : 1.0f;
+
+    /* Air band starts where the top band ends */
+    v->air_coeff = expf(-2.0f * (float)M_PI * v->freq_high / (float)SAMPLE_RATE);
+    v->air_att = 1.0f - expf(-1000.0f / (AIR_ATTACK_MS * (float)SAMPLE_RATE));
+    v->air_rel = 1.0f - expf(-1000.0f / (AIR_RELEASE_MS * (float)SAMPLE_RATE));
+
+    update_delays(v);
+
+    /* AGC smoothing runs once per chunk */
+    float chunk_ms = 1000.0f * (float)MAX_BLOCK / (float)SAMPLE_RATE;
+    v->agc_att_coeff = 1.0f - expf(-chunk_ms / v->agc_attack_ms);
+    v->agc_rel_coeff = 1.0f - expf(-chunk_ms / v->agc_release_ms);
+
+}
+
+/* Restart the carrier band levels at unity whitening gain, so a band
+ * with no carrier measured yet is not boosted to the limit */
+static void clear_carrier_levels(vocoder_instance_t *v) {
+    for (int i = 0; i < MAX_BANDS; i++) {
+        v->car_env_l[i].level = WHITEN_REF * WHITEN_REF;
+        v->car_env_r[i].level = WHITEN_REF * WHITEN_REF;
+        v->car_env_l[i].acc = 0.0f;
+        v->car_env_r[i].acc = 0.0f;
+    }
+}
+
+/* Reset envelopes to silence in the current detector's domain */
+static void clear_envelopes(vocoder_instance_t *v) {
+    float rest = (v->detector == DET_LOG) ? ENV_LOG_FLOOR : 0.0f;
+    for (int i = 0; i < MAX_BANDS; i++) {
+        v->mod_env_l[i].level = rest;
+        v->mod_env_r[i].level = rest;
+        v->mod_env_l[i].acc = 0.0f;
+        v->mod_env_r[i].acc = 0.0f;
+    }
+    memset(v->env_amp_l, 0, sizeof(v->env_amp_l));
+    memset(v->env_amp_r, 0, sizeof(v->env_amp_r));
+    memset(v->env_out_l, 0, sizeof(v->env_out_l));
+    memset(v->env_out_r, 0, sizeof(v->env_out_r));
+    clear_carrier_levels(v);
+}
+
+/* Forget the noise floor estimate (band layout changed) */
+static void clear_noise_floor(vocoder_instance_t *v) {
+    for (int i = 0; i < MAX_BANDS; i++) {
+        v->nf_min_l[i] = 1e9f;
+        v->nf_min_r[i] = 1e9f;
+        for (int w = 0; w < NF_WINDOWS; w++) {
+            v->nf_hist_l[w][i] = 1e9f;
+            v->nf_hist_r[w][i] = 1e9f;
+        }
+    }
+    memset(v->gate_sub_l, 0, sizeof(v->gate_sub_l));
+    memset(v->gate_sub_r, 0, sizeof(v->gate_sub_r));
+    v->nf_count = 0;
+    v->nf_slot = 0;
+}
+
+/* Clear the air band's filters, follower and delay line */
+static void clear_air(vocoder_instance_t *v) {
+    memset(&v->air_pre_l, 0, sizeof(v->air_pre_l));
+    memset(&v->air_pre_r, 0, sizeof(v->air_pre_r));
+    memset(&v->air_noise, 0, sizeof(v->air_noise));
+    v->air_env_l = 0.0f;
+    v->air_env_r = 0.0f;
+    memset(v->air_ring_l, 0, sizeof(v->air_ring_l));
+    memset(v->air_ring_r, 0, sizeof(v->air_ring_r));
+}
+
+/* Clear all filter states */
+static void clear_filters(vocoder_instance_t *v) {
+    memset(v->mod_svf_l, 0, sizeof(v->mod_svf_l));
+    memset(v->mod_svf_r, 0, sizeof(v->mod_svf_r));
+    memset(v->car_svf_l, 0, sizeof(v->car_svf_l));
+    memset(v->car_svf_r, 0, sizeof(v->car_svf_r));
+    memset(v->side_svf, 0, sizeof(v->side_svf));
+    memset(v->mod_quad_l, 0, sizeof(v->mod_quad_l));
+    memset(v->mod_quad_r, 0, sizeof(v->mod_quad_r));
+    memset(&v->mod_pre_l, 0, sizeof(v->mod_pre_l));
+    memset(&v->mod_pre_r, 0, sizeof(v->mod_pre_r));
+    clear_air(v);
+    clear_envelopes(v);
+    clear_noise_floor(v);
+}
+
+/* Forget the last CC values sent so every group is sent on the next tick */
+static void cc_reset(vocoder_instance_t *v) {
+    for (int g = 0; g < CC_MAX_GROUPS; g++)
+        v->cc_sent[g] = -1;
+    v->cc_timer = 0.0f;
+    v->cc_first = 0;
+}
+
+/* Simple JSON float extraction */
+static int json_get_float(const char *json, const char *key, float *out) {
+    char search[64];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+    const char *p = strstr(json, search);
+    if (!p) return -1;
+    p += strlen(search);
+    while (*p == ' ' || *p == '\t') p++;
+    *out = (float)atof(p);
+    return 0;
+}
+
+static int json_get_int(const char *json, const char *key, int *out) {
+    char search[64];
+    snprintf(search, sizeof(search), "\"%s\":", key);
+    const char *p = strstr(json, search);
+    if (!p) return -1;
+    p += strlen(search);
+    while (*p == ' ' || *p == '\t') p++;
+    *out = atoi(p);
+    return 0;
+}
+
+/* Snap band count to nearest valid value */
+static int snap_bands(int v) {
+    if (v <= 12) return 8;
+    if (v <= 20) return 16;
+    if (v <= 28) return 24;
+    return 32;
+}
+
+/* Parse an enum value given either as an option name or as an index */
+static int parse_enum(const char *val, const char *const *names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcasecmp(val, names[i]) == 0) return i;
+    }
+    return clampi(atoi(val), 0, count - 1);
+}
+
+/* ── Background worker ───────────────────────────────────────────────── */
+
+/*
+ * Estimate the modulator lag from the recorded envelopes: normalized
+ * cross-correlation over +-ALIGN_MAX_LAG hops, refined with a parabola
+ * through the peak. Positive lag means the modulator arrives late.
+ */
+static void estimate_align(vocoder_instance_t *v) {
+    float mod[ALIGN_HIST], car[ALIGN_HIST];
+    float mean_m = 0.0f, mean_c = 0.0f;
+
+    /* Copy the recording out and hand the buffers back straight away */
+    memcpy(mod, v->align_env_mod, sizeof(mod));
+    memcpy(car, v->align_env_car, sizeof(car));
+    int gen = v->align_shot_gen;
+    atomic_store_explicit(&v->align_shot_ready, 0, memory_order_release);
+    for (int i = 0; i < ALIGN_HIST; i++) {
+        mean_m += mod[i];
+        mean_c += car[i];
+    }
+    mean_m /= (float)ALIGN_HIST;
+    mean_c /= (float)ALIGN_HIST;
+
+    float var_m = 0.0f, var_c = 0.0f;
+    for (int i = 0; i < ALIGN_HIST; i++) {
+        mod[i] -= mean_m;
+        car[i] -= mean_c;
+        var_m += mod[i] * mod[i];
+        var_c += car[i] * car[i];
+    }
+
+    float corr[2 * ALIGN_MAX_LAG + 1];
+    int best = 0;
+    float norm = 1.0f / (sqrtf(var_m * var_c) + 1e-20f);
+    for (int lag = -ALIGN_MAX_LAG; lag <= ALIGN_MAX_LAG; lag++) {
+        float sum = 0.0f;
+        int lo = (lag > 0) ? lag : 0;
+        int hi = (lag > 0) ? ALIGN_HIST : ALIGN_HIST + lag;
+        for (int i = lo; i < hi; i++)
+            sum += mod[i] * car[i - lag];
+        corr[lag + ALIGN_MAX_LAG] = sum * norm;
+        if (sum * norm > corr[best]) best = lag + ALIGN_MAX_LAG;
+    }
+
+    float peak = corr[best];
+    float frac = 0.0f;
+    if (best > 0 && best < 2 * ALIGN_MAX_LAG) {
+        float a = corr[best - 1], c = corr[best + 1];
+        float den = a - 2.0f * peak + c;
+        if (den < 0.0f) frac = clampf(0.5f * (a - c) / den, -0.5f, 0.5f);
+    }
+
+    float lag_hops = (float)(best - ALIGN_MAX_LAG) + frac;
+    float ms = lag_hops * (float)ALIGN_HOP * 1000.0f / (float)SAMPLE_RATE;
+    v->align_result_gen = gen;
+    v->align_result_corr = peak;
+    v->align_result_ok = (peak >= ALIGN_MIN_CORR);
+    v->align_result_ms = clampf(ms, -ALIGN_MAX_MS, ALIGN_MAX_MS);
+    atomic_store_explicit(&v->align_result_ready, 1, memory_order_release);
+}
+
+/* Log-Hz position of a frequency on the learned spectrum's bin axis */
+static inline float adapt_bin(float hz) {
+    return (logf(hz / ADAPT_LO_HZ) / logf(ADAPT_HI_HZ / ADAPT_LO_HZ)) * (float)ADAPT_BINS;
+}
+
+/* Fold one voiced snapshot into the learned spectrum. Each band's share of
+ * the snapshot's power is spread evenly over the bins between the
+ * midpoints to its neighbours, so the estimate does not depend on the
+ * placement that measured it. */
+static void adapt_ingest(vocoder_instance_t *v, const adapt_snapshot_t *s) {
+    int n = s->bands;
+    v->adapt_bands = n;
+    v->adapt_lo = s->freq_low;
+    v->adapt_hi = s->freq_high;
+
+    float total = 0.0f;
+    for (int b = 0; b < n; b++)
+        total += s->power[b];
+    if (total < ADAPT_MIN_POWER || n < 2) return;
+
+    float shape[ADAPT_BINS] = { 0 };
+    for (int b = 0; b < n; b++) {
+        float c = adapt_bin(s->fc[b]);
+        float below = (b > 0)     ? c - adapt_bin(s->fc[b - 1]) : adapt_bin(s->fc[1]) - c;
+        float above = (b < n - 1) ? adapt_bin(s->fc[b + 1]) - c : c - adapt_bin(s->fc[n - 2]);
+        int i0 = clampi((int)(c - 0.5f * below), 0, ADAPT_BINS - 1);
+        int i1 = clampi((int)(c + 0.5f * above), i0, ADAPT_BINS - 1);
+        float share = s->power[b] / (total * (float)(i1 - i0 + 1));
+        for (int i = i0; i <= i1; i++)
+            shape[i] += share;
+    }
+    for (int i = 0; i < ADAPT_BINS; i++)
+        v->adapt_spec[i] = v->adapt_spec[i] * ADAPT_DECAY + shape[i] * (1.0f - ADAPT_DECAY);
+    v->adapt_voiced++;
+    v->adapt_learned++;
+}
+
+/*
+ * Energy-equalizing placement: each band covers an equal share of the
+ * (square-root compressed) learned spectrum between freq_low and
+ * freq_high, blended with an even share so quiet regions keep some bands.
+ * The outer centers stay on the range ends, like the fixed scales. The
+ * band count and range are the latest snapshot's, never the live
+ * parameters, which the control thread may be changing.
+ */
+static void adapt_place(vocoder_instance_t *v) {
+    int n = v->adapt_bands;
+    float lo = v->adapt_lo, hi = v->adapt_hi;
+    band_layout_t *P = &v->adapt_pending;
+
+    float b_lo = adapt_bin(lo), b_hi = adapt_bin(hi);
+    float cum[ADAPT_BINS + 1];
+    cum[0] = 0.0f;
+    for (int i = 0; i < ADAPT_BINS; i++) {
+        float t = b_lo + ((float)i + 0.5f) * (b_hi - b_lo) / (float)ADAPT_BINS;
+        int k = clampi((int)t, 0, ADAPT_BINS - 1);
+        cum[i + 1] = cum[i] + sqrtf(v->adapt_spec[k]);
+    }
+    float total = cum[ADAPT_BINS];
+    if (total <= 0.0f) return;
+    for (int i = 0; i <= ADAPT_BINS; i++)
+        cum[i] = (1.0f - ADAPT_FLOOR) * cum[i] / total + ADAPT_FLOOR * (float)i / (float)ADAPT_BINS;
+
+    float fc[MAX_BANDS];
+    float log_lo = logf(lo), log_hi = logf(hi);
+    int j = 0;
+    for (int b = 0; b < n; b++) {
+        /* Invert the blended cumulative between bin edges j and j + 1 */
+        float q = (float)b / (float)(n - 1);
+        while (j < ADAPT_BINS - 1 && cum[j + 1] < q) j++;
+        float t = (cum[j + 1] > cum[j]) ? clampf((q - cum[j]) / (cum[j + 1] - cum[j]), 0.0f, 1.0f) : 0.0f;
+        float x = ((float)j + t) / (float)ADAPT_BINS;
+        fc[b] = expf(log_lo + x * (log_hi - log_lo));
+    }
+    fc[0] = lo;
+    fc[n - 1] = hi;
+    for (int b = 1; b < n; b++)
+        fc[b] = fmaxf(fc[b], fc[b - 1] * ADAPT_MIN_RATIO);
+    fc[n - 1] = hi;
+    for (int b = n - 2; b > 0; b--)
+        fc[b] = fminf(fc[b], fc[b + 1] / ADAPT_MIN_RATIO);
+
+    /* Skip swaps that would barely move anything */
+    if (P->valid && P->bands == n && P->freq_low == lo && P->freq_high == hi) {
+        float moved = 0.0f;
+        for (int b = 0; b < n; b++)
+            moved = fmaxf(moved, fabsf(logf(fc[b] / P->fc[b])));
+        if (moved < ADAPT_MOVE) return;
+    }
+
+    memcpy(P->fc, fc, sizeof(float) * n);
+    layout_coeffs(P, n, lo, hi);
+    P->scale     = SCALE_ADAPTIVE;
+    P->bands     = n;
+    P->freq_low  = lo;
+    P->freq_high = hi;
+    P->valid     = 1;
+    atomic_store_explicit(&v->adapt_ready, 1, memory_order_release);
+}
+
+/* Worker side of the adaptive layout: drain snapshots, re-place periodically
+ * or as soon as the snapshots' band count or range no longer matches.
+ * Snapshots only arrive while Scale is Adaptive */
+static void adapt_learn(vocoder_instance_t *v) {
+    if (atomic_exchange(&v->adapt_reset, 0)) {
+        memset(v->adapt_spec, 0, sizeof(v->adapt_spec));
+        v->adapt_voiced = 0;
+        v->adapt_learned = 0;
+    }
+
+    unsigned rd = atomic_load_explicit(&v->adapt_read, memory_order_relaxed);
+    unsigned wr = atomic_load_explicit(&v->adapt_write, memory_order_acquire);
+    for (; rd != wr; rd++)
+        adapt_ingest(v, &v->adapt_ring[rd % ADAPT_RING]);
+    atomic_store_explicit(&v->adapt_read, rd, memory_order_release);
+
+    if (atomic_load_explicit(&v->adapt_ready, memory_order_acquire) ||
+        v->adapt_learned < ADAPT_UPDATE)
+        return;
+    const band_layout_t *P = &v->adapt_pending;
+    int stale = !P->valid || P->bands != v->adapt_bands ||
+                P->freq_low != v->adapt_lo || P->freq_high != v->adapt_hi;
+    if (stale || v->adapt_voiced >= ADAPT_UPDATE) {
+        v->adapt_voiced = 0;
+        adapt_place(v);
+    }
+}
+
+static void *worker_main(void *arg) {
+    vocoder_instance_t *v = (vocoder_instance_t *)arg;
+    struct timespec ts = { 0, WORKER_PERIOD_MS * 1000000L };
+
+    while (atomic_load(&v->worker_run)) {
+        if (atomic_load_explicit(&v->align_shot_ready, memory_order_acquire) &&
+            !atomic_load_explicit(&v->align_result_ready, memory_order_acquire))
+            estimate_align(v);
+        adapt_learn(v);
+        nanosleep(&ts, NULL);
+    }
+    return NULL;
+}
+
+/* Start the worker on first use (control thread) */
+static void worker_start(vocoder_instance_t *v) {
+    if (v->worker_started) return;
+    atomic_store(&v->worker_run, 1);
+    if (pthread_create(&v->worker, NULL, worker_main, v) == 0) {
+        v->worker_started = 1;
+    } else {
+        atomic_store(&v->worker_run, 0);
+        voc_log("Failed to start worker thread");
+    }
+}
+
+static void worker_stop(vocoder_instance_t *v) {
+    if (!v->worker_started) return;
+    atomic_store(&v->worker_run, 0);
+    pthread_join(v->worker, NULL);
+    v->worker_started = 0;
+}
+
+/* ── Instance pool ───────────────────────────────────────────────────── */
+
+/*
+ * Scrolling through chain presets creates and destroys instances in quick
+ * succession. Released instances are reset and kept, up to pool_size
+ * (module.json defaults, passed as config_json), so create is a pointer
+ * pop plus the per-instance setup: the default settings and their
+ * coefficients are computed on release, and the reset clears the instance
+ * in place, leaving every page of a pooled instance faulted in. Pooled
+ * instances live as long as the process, and keep the lock initialized
+ * with them.
+ */
+#define POOL_MAX 8
+#define POOL_DEFAULT 2
+
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static vocoder_instance_t *g_pool[POOL_MAX];
+static int g_pool_count = 0;
+static int g_pool_size = -1;    /* read from the first create's config_json */
+
+/* Default parameters and the coefficients they imply */
+static void init_defaults(vocoder_instance_t *v) {
+    v->bands       = 16;
+    v->freq_low    = 100.0f;
+    v->freq_high   = 8000.0f;
+    v->attack_ms   = 5.0f;
+    v->release_ms  = 50.0f;
+    v->mod_gain    = 2.0f;
+    v->output_gain = 2.0f;
+    v->mix         = 1.0f;
+    v->carrier_mix = 0.1f;
+    v->env_scale   = 1.0f;
+    v->width       = 0.7f;
+    v->side_bands  = SIDE_QUARTER;
+    v->quality     = QUALITY_STANDARD;
+    v->env_rate    = ENV_RATE_NORMAL;
+    v->ns_per_unit = COST_NS_PER_UNIT;
+    v->priority    = PRIORITY_NORMAL;
+    v->pitch_depth = 1.0f;
+    v->cc_groups   = 4;
+    v->cc_base     = 20;
+    v->cc_channel  = 1;
+    v->cc_rate     = 30.0f;
+    v->cc_thresh   = 2;
+    cc_reset(v);
+    v->coord_slot  = -1;
+    v->agc_target  = -20.0f;
+    v->agc_max     = 20.0f;
+    v->agc_attack_ms  = 50.0f;
+    v->agc_release_ms = 500.0f;
+    v->agc_gain_lin   = 1.0f;
+    v->input_level_db = -120.0f;
+    clear_noise_floor(v);
+    clear_carrier_levels(v);
+    v->noise_seed  = 12345;
+    v->param_version = 1;
+
+    recalc_bands(v);
+}
+
+/* An instance, zeroed, with its lock initialized for as long as it lives;
+ * NULL if out of memory */
+static vocoder_instance_t *instance_alloc(void) {
+    vocoder_instance_t *v = (vocoder_instance_t *)calloc(1, sizeof(vocoder_instance_t));
+    if (!v) return NULL;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&v->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return v;
+}
+
+static void instance_free(vocoder_instance_t *v) {
+    pthread_mutex_destroy(&v->lock);
+    free(v);
+}
+
+/* Clear everything but the lock and take the default settings */
+static void pool_reset(vocoder_instance_t *v) {
+    memset(v, 0, offsetof(vocoder_instance_t, lock));
+    init_defaults(v);
+}
+
+/* First create: size the pool and fill it (control thread, lock held) */
+static void pool_init(const char *config_json) {
+    int size = POOL_DEFAULT;
+    if (config_json)
+        json_get_int(config_json, "pool_size", &size);
+    g_pool_size = clampi(size, 0, POOL_MAX);
+    if (g_pool_size == 0) return;
+
+    while (g_pool_count < g_pool_size) {
+        vocoder_instance_t *v = instance_alloc();
+        if (!v) break;
+        init_defaults(v);
+        g_pool[g_pool_count++] = v;
+    }
+}
+
+static vocoder_instance_t *pool_acquire(const char *config_json) {
+    vocoder_instance_t *v = NULL;
+    pthread_mutex_lock(&g_pool_lock);
+    if (g_pool_size < 0)
+        pool_init(config_json);
+    if (g_pool_count > 0)
+        v = g_pool[--g_pool_count];
+    pthread_mutex_unlock(&g_pool_lock);
+    return v;
+}
+
+/* Reset a released instance to defaults and keep it, or free it if the
+ * pool is full. The worker, coordinator slot and mod source are already
+ * released. */
+static void pool_release(vocoder_instance_t *v) {
+    pthread_mutex_lock(&g_pool_lock);
+    if (g_pool_count < g_pool_size) {
+        pool_reset(v);
+        g_pool[g_pool_count++] = v;
+        v = NULL;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+    if (v) instance_free(v);
+}
+
+/* ── V2 API ──────────────────────────────────────────────────────────── */
+
+/* First create: take the shared budget from the module defaults */
+static void coord_configure(const char *config_json) {
+    float pct;
+    if (atomic_exchange(&g_coord_configured, 1)) return;
+    if (config_json && json_get_float(config_json, "cpu_budget", &pct) == 0)
+        atomic_store(&g_coord_budget_pct, (int)clampf(pct, 10.0f, 100.0f));
+}
+
+static void* v2_create_instance(const char *module_dir, const char *config_json) {
+    (void)module_dir;
+
+    voc_log("Creating instance");
+
+    /* A pooled instance was reset in place from the default settings when
+     * it was released and keeps its lock; otherwise start fresh */
+    vocoder_instance_t *v = pool_acquire(config_json);
+    if (!v) {
+        v = instance_alloc();
+        if (!v) {
+            voc_log("Failed to allocate instance");
+            return NULL;
+        }
+        init_defaults(v);
+    }
+
+    snprintf(v->mod_source, sizeof(v->mod_source), "vocoder-%08x", (unsigned)(uintptr_t)v);
+    coord_configure(config_json);
+    v->coord_slot  = coord_register();
+    if (v->coord_slot < 0)
+        voc_log("No CPU coordinator slot free, running uncoordinated");
+
+    voc_log("Instance created");
+    return v;
+}
+
+static void v2_destroy_instance(void *instance) {
+    vocoder_instance_t *v = (vocoder_instance_t *)instance;
+    if (!v) return;
+    voc_log("Destroying instance");
+    worker_stop(v);
+    coord_deregister(v->coord_slot);
+    if (v->pitch_emitted && g_host && g_host->mod_clear_source)
+        g_host->mod_clear_source(g_host->mod_host_ctx, v->mod_source);
+    pool_release(v);
+}
+
+/* M/S: refresh the side envelopes of every group with a band in [first, n) */
+static void update_side(vocoder_instance_t *v, int first, int n) {
+    int shift = v->side_shift;
+    for (int g = first >> shift; g < (n >> shift); g++) {
+        float sum = 0.0f;
+        for (int b = g << shift; b < (g + 1) << shift; b++)
+            sum += v->env_out_l[b];
+        v->side_env[g] = sum * v->side_comp[g];
+    }
+}
+
+/* Run the envelope smoothers for bands [first, n), one loop per detector,
+ * then gate and fold in the per-band gains */
+static void update_envelopes(vocoder_instance_t *v, int det, int first, int n) {
+    int dual = (v->stereo == STEREO_DUAL && !v->run_mono_mod);
+    env_state_t *el = v->mod_env_l;
+    env_state_t *er = v->mod_env_r;
+    const float *att = v->band_att;
+    const float *rel = v->band_rel;
+    const float *norm = v->band_gain;
+
+    switch (det) {
+    case DET_RMS: {
+        const float *inv_len = v->band_inv_len;
+        float gain = (v->run_analysis == ANALYSIS_QUAD) ? 1.0f : 2.0f;
+        for (int b = first; b < n; b++) {
+            v->env_amp_l[b] = env_update_rms(&el[b], att[b], rel[b], inv_len[b], gain);
+            if (dual) v->env_amp_r[b] = env_update_rms(&er[b], att[b], rel[b], inv_len[b], gain);
+        }
+        break;
+    }
+    case DET_LOG:
+        for (int b = first; b < n; b++) {
+            v->env_amp_l[b] = env_update_log(&el[b], att[b], rel[b]);
+            if (dual) v->env_amp_r[b] = env_update_log(&er[b], att[b], rel[b]);
+        }
+        break;
+    default:
+        for (int b = first; b < n; b++) {
+            v->env_amp_l[b] = env_update_peak(&el[b], att[b], rel[b]);
+            if (dual) v->env_amp_r[b] = env_update_peak(&er[b], att[b], rel[b]);
+        }
+        break;
+    }
+
+    /* A shared modulator analysis feeds both carrier channels */
+    if (v->run_mono_mod)
+        memcpy(&v->env_amp_r[first], &v->env_amp_l[first], (size_t)(n - first) * sizeof(float));
+
+    /* Spectral gate: subtract the scaled noise floor (zero when gate is off) */
+    for (int b = first; b < n; b++) {
+        v->env_out_l[b] = fmaxf(v->env_amp_l[b] - v->gate_sub_l[b], 0.0f) * norm[b];
+        v->env_out_r[b] = fmaxf(v->env_amp_r[b] - v->gate_sub_r[b], 0.0f) * norm[b];
+    }
+
+    /* Carrier whitening folds into the same per-band envelope gain. A band
+     * skipped this chunk measured no carrier, so its level holds rather
+     * than decaying toward the boost limit while the band is gated. */
+    if (v->whiten > 0.0f) {
+        const float *inv_len = v->band_inv_len;
+        float amount = v->whiten;
+        for (int b = first; b < n; b++) {
+            if (!v->band_active[b]) {
+                v->env_out_l[b] *= whiten_gain(&v->car_env_l[b], amount);
+                if (dual) v->env_out_r[b] *= whiten_gain(&v->car_env_r[b], amount);
+                continue;
+            }
+            v->env_out_l[b] *= whiten_update(&v->car_env_l[b], att[b], rel[b], inv_len[b], amount);
+            if (dual) v->env_out_r[b] *= whiten_update(&v->car_env_r[b], att[b], rel[b], inv_len[b], amount);
+        }
+    }
+
+    if (v->stereo == STEREO_MS)
+        update_side(v, first, n);
+}
+
+/*
+ * Chunk-rate noise floor: minimum statistics over NF_WINDOWS sub-windows of
+ * the detector output, biased up to approximate the noise mean. Feeds the
+ * gate subtraction used by update_envelopes.
+ */
+static void update_noise_floor(vocoder_instance_t *v, int n) {
+    for (int b = 0; b < n; b++) {
+        v->nf_min_l[b] = fminf(v->nf_min_l[b], v->env_amp_l[b]);
+        v->nf_min_r[b] = fminf(v->nf_min_r[b], v->env_amp_r[b]);
+    }
+
+    if (++v->nf_count >= NF_SUBWIN) {
+        int slot = v->nf_slot;
+        memcpy(v->nf_hist_l[slot], v->nf_min_l, sizeof(float) * n);
+        memcpy(v->nf_hist_r[slot], v->nf_min_r, sizeof(float) * n);
+        v->nf_slot = (slot + 1) % NF_WINDOWS;
+        v->nf_count = 0;
+        for (int b = 0; b < n; b++) {
+            v->nf_min_l[b] = 1e9f;
+            v->nf_min_r[b] = 1e9f;
+        }
+    }
+
+    float k = 2.0f * NF_BIAS * v->gate;
+    for (int b = 0; b < n; b++) {
+        float fl = v->nf_min_l[b];
+        float fr = v->nf_min_r[b];
+        for (int w = 0; w < NF_WINDOWS; w++) {
+            fl = fminf(fl, v->nf_hist_l[w][b]);
+            fr = fminf(fr, v->nf_hist_r[w][b]);
+        }
+        v->gate_sub_l[b] = k * fl;
+        v->gate_sub_r[b] = k * fr;
+    }
+}
+
+/* Push a chunk through a delay ring (write, then read `delay` back) */
+static inline void ring_delay(float *ring, uint32_t pos, float *buf, int frames,
+                              uint32_t delay) {
+    const uint32_t mask = DELAY_RING_SIZE - 1;
+    for (int i = 0; i < frames; i++) {
+        ring[(pos + i) & mask] = buf[i];
+        buf[i] = ring[(pos + i - delay) & mask];
+    }
+}
+
+/* Apply alignment delays to modulator/carrier and latency compensation to
+ * the dry path. Rings are always written so delay changes take effect
+ * without stale audio. */
+static void apply_delays(vocoder_instance_t *v, int frames) {
+    uint32_t pos = v->delay_pos;
+    ring_delay(v->dry_ring_l, pos, v->dry_buf_l, frames, (uint32_t)v->latency);
+    ring_delay(v->dry_ring_r, pos, v->dry_buf_r, frames, (uint32_t)v->latency);
+    ring_delay(v->mod_ring_l, pos, v->mod_buf_l, frames, (uint32_t)v->mod_delay);
+    ring_delay(v->mod_ring_r, pos, v->mod_buf_r, frames, (uint32_t)v->mod_delay);
+    ring_delay(v->car_ring_l, pos, v->car_buf_l, frames, (uint32_t)v->car_delay);
+    ring_delay(v->car_ring_r, pos, v->car_buf_r, frames, (uint32_t)v->car_delay);
+    if (v->air > 0.0f) {
+        ring_delay(v->air_ring_l, pos, v->air_buf_l, frames, (uint32_t)v->air_delay);
+        ring_delay(v->air_ring_r, pos, v->air_buf_r, frames, (uint32_t)v->air_delay);
+    }
+    v->delay_pos = pos + (uint32_t)frames;
+}
+
+/* Record hop-rate modulator/carrier envelopes for the alignment estimate.
+ * Runs before the alignment delays so it sees the raw misalignment. */
+static void record_align(vocoder_instance_t *v, int frames) {
+    if (atomic_load_explicit(&v->align_status, memory_order_relaxed) != ALIGN_LISTEN)
+        return;
+    int count = v->align_count;
+    if (count >= ALIGN_HIST) return;
+
+    for (int i = 0; i < frames; i++) {
+        v->align_acc_mod += fabsf(v->mod_buf_l[i] + v->mod_buf_r[i]);
+        v->align_acc_car += fabsf(v->dry_buf_l[i] + v->dry_buf_r[i]);
+        if (++v->align_hop_pos == ALIGN_HOP) {
+            v->align_env_mod[count] = v->align_acc_mod;
+            v->align_env_car[count] = v->align_acc_car;
+            v->align_acc_mod = 0.0f;
+            v->align_acc_car = 0.0f;
+            v->align_hop_pos = 0;
+            if (++count >= ALIGN_HIST) break;
+        }
+    }
+    v->align_count = count;
+    if (count >= ALIGN_HIST) {
+        v->align_shot_gen = v->align_gen;
+        atomic_store_explicit(&v->align_shot_ready, 1, memory_order_release);
+    }
+}
+
+/* Queue an envelope snapshot for the adaptive layout every ADAPT_HOP
+ * chunks; dropped when the worker has fallen behind */
+static void record_adapt(vocoder_instance_t *v, int n) {
+    if (v->scale != SCALE_ADAPTIVE || ++v->adapt_hop_pos < ADAPT_HOP)
+        return;
+    v->adapt_hop_pos = 0;
+
+    unsigned wr = atomic_load_explicit(&v->adapt_write, memory_order_relaxed);
+    if (wr - atomic_load_explicit(&v->adapt_read, memory_order_acquire) >= ADAPT_RING)
+        return;
+    adapt_snapshot_t *s = &v->adapt_ring[wr % ADAPT_RING];
+    int dual = (v->stereo == STEREO_DUAL && !v->run_mono_mod);
+    s->bands = n;
+    s->freq_low = v->freq_low;
+    s->freq_high = v->freq_high;
+    memcpy(s->fc, v->band_fc, sizeof(float) * n);
+    for (int b = 0; b < n; b++) {
+        float l = v->env_amp_l[b], r = v->env_amp_r[b];
+        s->power[b] = dual ? 0.5f * (l * l + r * r) : l * l;
+    }
+    atomic_store_explicit(&v->adapt_write, wr + 1, memory_order_release);
+}
+
+/* Rederive every per-band value from adapt_layout, keeping the filter
+ * coefficients as they are (mid-glide, or just restored) */
+static void rederive_keep_filters(vocoder_instance_t *v) {
+    float f[MAX_BANDS], q[MAX_BANDS];
+    memcpy(f, v->band_f, sizeof(f));
+    memcpy(q, v->band_q, sizeof(q));
+    recalc_bands(v);
+    memcpy(v->band_f, f, sizeof(f));
+    memcpy(v->band_q, q, sizeof(q));
+    for (int b = 0; b < v->bands; b++)
+        v->band_quad_k[b] = quad_k(v->band_f[b]);
+}
+
+/* Adopt a new adaptive placement: derived values jump, filter coefficients
+ * glide from the old placement over ADAPT_GLIDE chunks */
+static void poll_adapt_layout(vocoder_instance_t *v) {
+    if (!atomic_load_explicit(&v->adapt_ready, memory_order_acquire))
+        return;
+    const band_layout_t *P = &v->adapt_pending;
+    if (v->scale == SCALE_ADAPTIVE && P->bands == v->bands &&
+        P->freq_low == v->freq_low && P->freq_high == v->freq_high) {
+        v->adapt_layout = *P;
+        rederive_keep_filters(v);
+        v->adapt_glide = ADAPT_GLIDE;
+    }
+    atomic_store_explicit(&v->adapt_ready, 0, memory_order_release);
+}
+
+/* Step a glide toward the adaptive placement; one left running after the
+ * scale or band count moved on is dropped */
+static void glide_layout(vocoder_instance_t *v) {
+    if (v->adapt_glide <= 0) return;
+    const band_layout_t *L = &v->adapt_layout;
+    if (v->scale != SCALE_ADAPTIVE || L->bands != v->bands) {
+        v->adapt_glide = 0;
+        return;
+    }
+    float t = 1.0f / (float)v->adapt_glide--;
+    for (int b = 0; b < v->bands; b++) {
+        v->band_fc[b] += (L->fc[b] - v->band_fc[b]) * t;
+        v->band_f[b] += (L->f[b] - v->band_f[b]) * t;
+        v->band_q[b] += (L->q[b] - v->band_q[b]) * t;
+        v->band_quad_k[b] = quad_k(v->band_f[b]);
+    }
+}
+
+/*
+ * Take alignment requests from the control thread and estimates from the
+ * worker. Only this thread touches the recorder and the status, so a
+ * restart never races the recording. A restart waits while the worker
+ * still has to copy the last recording out. An estimate whose
+ * generation predates the latest request is dropped.
+ */
+static void poll_align(vocoder_instance_t *v) {
+    int req = atomic_load_explicit(&v->align_request, memory_order_relaxed);
+    if (req != ALIGN_REQ_NONE &&
+        !(req == ALIGN_REQ_START &&
+          atomic_load_explicit(&v->align_shot_ready, memory_order_acquire)) &&
+        atomic_compare_exchange_strong(&v->align_request, &req, ALIGN_REQ_NONE)) {
+        v->align_gen++;
+        if (req == ALIGN_REQ_START) {
+            v->align_count = 0;
+            v->align_acc_mod = 0.0f;
+            v->align_acc_car = 0.0f;
+            v->align_hop_pos = 0;
+            atomic_store(&v->align_status, ALIGN_LISTEN);
+        } else if (atomic_load(&v->align_status) == ALIGN_LISTEN) {
+            atomic_store(&v->align_status, ALIGN_IDLE);
+        }
+    }
+
+    if (atomic_load_explicit(&v->align_result_ready, memory_order_acquire)) {
+        if (v->align_result_gen == v->align_gen &&
+            atomic_load(&v->align_status) == ALIGN_LISTEN) {
+            v->align_corr = v->align_result_corr;
+            if (v->align_result_ok) {
+                v->align_ms = v->align_result_ms;
+                update_delays(v);
+                atomic_fetch_add(&v->param_version, 1);
+                atomic_store(&v->align_status, ALIGN_DONE);
+            } else {
+                atomic_store(&v->align_status, ALIGN_FAILED);
+            }
+        }
+        atomic_store_explicit(&v->align_result_ready, 0, memory_order_release);
+    }
+}
+
+/* Build the list of carrier bands worth filtering this chunk. A band whose
+ * gated envelope is closed on both sides is skipped; its carrier state is
+ * cleared so it restarts from rest when the envelope reopens (which then
+ * takes effect from the next chunk). */
+static void update_active_bands(vocoder_instance_t *v, int n) {
+    int count = 0;
+    for (int b = 0; b < n; b++) {
+        int active = (v->env_out_l[b] > 0.0f || v->env_out_r[b] > 0.0f);
+        if (!active && v->band_active[b]) {
+            memset(&v->car_svf_l[b], 0, sizeof(svf_state_t));
+            memset(&v->car_svf_r[b], 0, sizeof(svf_state_t));
+            v->car_env_l[b].acc = 0.0f;
+            v->car_env_r[b].acc = 0.0f;
+        }
+        v->band_active[b] = (uint8_t)active;
+        if (active) v->active_list[count++] = b;
+    }
+    v->active_count = count;
+}
+
+/* The carrier rings delay whatever domain the pre-pass writes; on a switch
+ * into or out of M/S, convert the samples still in flight */
+static void convert_carrier_rings(vocoder_instance_t *v, int ms) {
+    float k = ms ? 0.5f : 1.0f;
+    for (int i = 0; i < DELAY_RING_SIZE; i++) {
+        float a = v->car_ring_l[i];
+        float b = v->car_ring_r[i];
+        v->car_ring_l[i] = k * (a + b);
+        v->car_ring_r[i] = k * (a - b);
+    }
+    v->car_ring_ms = ms;
+}
+
+/*
+ * Pre-pass: convert one chunk of carrier and modulator to float. The
+ * modulator's high-pass (DC blocker and/or rumble filter), pre-emphasis
+ * and gain are folded into the same loop, so conditioning costs a few
+ * instructions per sample. The carrier picks up the unvoiced noise here,
+ * and in M/S mode is encoded to mid (L buffer) and side (R buffer); the
+ * air band is split off the conditioned modulator with one more one-pole
+ * high-pass.
+ * The conditioned modulator's sum of squares is gathered in the same loop
+ * and drives the level meter and AGC once per chunk; AGC gain changes are
+ * ramped across the following chunk.
+ */
+static void prepare_inputs(vocoder_instance_t *v, const int16_t *audio_in,
+                           const int16_t *mic_in, int frames) {
+    float mod_gain = v->mod_gain;
+    float noise_mix = v->carrier_mix;
+    float hp = v->hp_coeff;
+    float pe = v->pre_emph;
+    precond_state_t pl = v->mod_pre_l;
+    precond_state_t pr = v->mod_pre_r;
+    int air = (v->air > 0.0f);
+    int air_noise = (v->air_mode == AIR_NOISE);
+    float ac = v->air_coeff;
+    precond_state_t al = v->air_pre_l;
+    precond_state_t ar = v->air_pre_r;
+    precond_state_t an = v->air_noise;
+    float env_l = v->air_env_l;
+    float env_r = v->air_env_r;
+    int ms = (v->stereo == STEREO_MS);
+    if (ms != v->car_ring_ms)
+        convert_carrier_rings(v, ms);
+
+    float agc_from = v->agc_gain_lin;
+    float agc_to = v->agc ? fast_exp2(v->agc_gain_db * DB_TO_LOG2) : 1.0f;
+    float gain = mod_gain * agc_from;
+    float gain_step = mod_gain * (agc_to - agc_from) / (float)frames;
+    float sum_sq = 0.0f;
+
+    for (int i = 0; i < frames; i++) {
+        /* Convert carrier (synth output) to float */
+        float car_l = audio_in[i * 2]     / 32768.0f;
+        float car_r = audio_in[i * 2 + 1] / 32768.0f;
+        v->dry_buf_l[i] = car_l;
+        v->dry_buf_r[i] = car_r;
+
+        /* Add noise to carrier for unvoiced/consonant content; in M/S it
+         * is common to both channels, so it all lands in the mid */
+        float ns = noise_sample(&v->noise_seed);
+        if (ms) {
+            v->car_buf_l[i] = 0.5f * (car_l + car_r) + ns * noise_mix;
+            v->car_buf_r[i] = 0.5f * (car_l - car_r);
+        } else {
+            v->car_buf_l[i] = car_l + ns * noise_mix;
+            v->car_buf_r[i] = car_r + ns * noise_mix;
+        }
+
+        /* Modulator (mic input): one-pole high-pass, then pre-emphasis */
+        float xl = mic_in[i * 2]     / 32768.0f;
+        float xr = mic_in[i * 2 + 1] / 32768.0f;
+        float yl = hp * (pl.y1 + xl - pl.x1);
+        float yr = hp * (pr.y1 + xr - pr.x1);
+        float ml = yl - pe * pl.y1;
+        float mr = yr - pe * pr.y1;
+        sum_sq += ml * ml + mr * mr;
+        gain += gain_step;
+        ml *= gain;
+        mr *= gain;
+        v->mod_buf_l[i] = ml;
+        v->mod_buf_r[i] = mr;
+        pl.x1 = xl; pl.y1 = yl;
+        pr.x1 = xr; pr.y1 = yr;
+
+        if (air) {
+            float hl = ac * (al.y1 + ml - al.x1);
+            float hr = ac * (ar.y1 + mr - ar.x1);
+            al.x1 = ml; al.y1 = hl;
+            ar.x1 = mr; ar.y1 = hr;
+            if (air_noise) {
+                float hn = ac * (an.y1 + ns - an.x1);
+                an.x1 = ns; an.y1 = hn;
+                float dl = fabsf(hl) - env_l;
+                float dr = fabsf(hr) - env_r;
+                env_l += (dl > 0.0f ? v->air_att : v->air_rel) * dl;
+                env_r += (dr > 0.0f ? v->air_att : v->air_rel) * dr;
+                hl = hn * env_l * AIR_NOISE_GAIN;
+                hr = hn * env_r * AIR_NOISE_GAIN;
+            }
+            v->air_buf_l[i] = hl;
+            v->air_buf_r[i] = hr;
+        }
+    }
+
+    v->air_pre_l = al;
+    v->air_pre_r = ar;
+    v->air_noise = an;
+    v->air_env_l = env_l;
+    v->air_env_r = env_r;
+
+    v->mod_pre_l = pl;
+    v->mod_pre_r = pr;
+    v->agc_gain_lin = agc_to;
+
+    /* Meter: 10*log10(mean square) */
+    float level_db = 10.0f / 3.3219281f * fast_log2(sum_sq / (float)(2 * frames) + 1e-12f);
+    v->input_level_db = level_db;
+
+    /* AGC aims the post-Mod-Gain level at the target, so a misset Mod Gain
+     * is absorbed as long as the correction stays within range */
+    if (v->agc && level_db > AGC_GATE_DB && mod_gain > 0.0f) {
+        float gain_db = 20.0f / 3.3219281f * fast_log2(mod_gain);
+        float want = clampf(v->agc_target - level_db - gain_db, AGC_MIN_DB, v->agc_max);
+        float coeff = (want < v->agc_gain_db) ? v->agc_att_coeff : v->agc_rel_coeff;
+        v->agc_gain_db += coeff * (want - v->agc_gain_db);
+    }
+}
+
+/* Filter one modulator sample through a band and feed its detector */
+static inline void analyze_band(svf_state_t *svf, quad_state_t *qs, env_state_t *env,
+                                float x, float f, float q, float k,
+                                int quad, int det_sum) {
+    float band = svf_bandpass(svf, x, f, q);
+    float p = quad ? quad_power(qs, band, k) : band * band;
+    env_detect(env, p, det_sum);
+}
+
+/* Smooth the envelopes of bands whose update interval ends at this sample */
+static inline void tick_envelopes(vocoder_instance_t *v, int det, int n) {
+    uint32_t phase = ++v->env_phase;
+    int first = v->rate_start[__builtin_ctz(phase | (1u << ENV_MAX_SHIFT))];
+    if (first < n)
+        update_envelopes(v, det, first, n);
+}
+
+/*
+ * Formant shift and band sweep: the carrier bank is scaled by
+ * 2^(semitones/12) against the modulator bank, moving the voice's formants
+ * on the carrier. Called every FORMANT_STEP samples from the vocode loops;
+ * retuning every band costs one fast_sin each, which vectorizes across
+ * bands.
+ */
+static int formant_live(const vocoder_instance_t *v) {
+    return v->formant != 0.0f || v->sweep_depth > 0.0f || fabsf(v->formant_cur) > 1e-3f;
+}
+
+static void update_formant(vocoder_instance_t *v) {
+    v->formant_cur += (v->formant - v->formant_cur) * v->formant_coeff;
+    float semis = v->formant_cur;
+    if (v->sweep_depth > 0.0f) {
+        v->sweep_phase += v->sweep_rate * ((float)FORMANT_STEP / (float)SAMPLE_RATE);
+        v->sweep_phase -= floorf(v->sweep_phase);
+        semis += v->sweep_depth * fast_sin(6.2831853f * v->sweep_phase);
+    }
+    float w = fast_exp2(semis * (1.0f / 12.0f)) * ((float)M_PI / (float)SAMPLE_RATE);
+
+    int n = v->bands;
+    for (int b = 0; b < n; b++)
+        v->car_f[b] = 2.0f * fast_sin(fminf(v->band_fc[b] * w, FORMANT_MAX_W));
+    if (v->stereo == STEREO_MS) {
+        for (int g = 0; g < (n >> v->side_shift); g++)
+            v->car_side_f[g] = 2.0f * fast_sin(fminf(v->side_fc[g] * w, FORMANT_MAX_W));
+    }
+}
+
+/* Dual: independent L/R modulator analysis and carrier banks */
+static void vocode_dual(vocoder_instance_t *v, int frames) {
+    int n = v->bands;
+    int det = v->detector;
+    int det_sum = (det == DET_RMS);
+    int quad = (v->run_analysis == ANALYSIS_QUAD);
+    int whiten = (v->whiten > 0.0f);
+    int mono_mod = v->run_mono_mod;
+    int na = v->active_count;
+    const int *act = v->active_list;
+    int shift = formant_live(v);
+    const float *cf = shift ? v->car_f : v->band_f;
+
+    for (int i = 0; i < frames; i++) {
+        if (shift && !(i & (FORMANT_STEP - 1)))
+            update_formant(v);
+        float mod_l = v->mod_buf_l[i];
+        float mod_r = v->mod_buf_r[i];
+        float car_noise_l = v->car_buf_l[i];
+        float car_noise_r = v->car_buf_r[i];
+
+        if (mono_mod) {
+            float mod = 0.5f * (mod_l + mod_r);
+            for (int b = 0; b < n; b++)
+                analyze_band(&v->mod_svf_l[b], &v->mod_quad_l[b], &v->mod_env_l[b],
+                             mod, v->band_f[b], v->band_q[b], v->band_quad_k[b], quad, det_sum);
+        } else for (int b = 0; b < n; b++) {
+            float f = v->band_f[b];
+            float q = v->band_q[b];
+            float k = v->band_quad_k[b];
+
+            /* Filter modulator through bandpass → envelope detector */
+            analyze_band(&v->mod_svf_l[b], &v->mod_quad_l[b], &v->mod_env_l[b],
+                         mod_l, f, q, k, quad, det_sum);
+            analyze_band(&v->mod_svf_r[b], &v->mod_quad_r[b], &v->mod_env_r[b],
+                         mod_r, f, q, k, quad, det_sum);
+        }
+
+        /* Accumulate vocoded output across bands */
+        float out_l = 0.0f;
+        float out_r = 0.0f;
+
+        for (int j = 0; j < na; j++) {
+            int b = act[j];
+            float f = cf[b];
+            float q = v->band_q[b];
+
+            /* Filter carrier through the matching (possibly shifted) bandpass */
+            float car_band_l = svf_bandpass(&v->car_svf_l[b], car_noise_l, f, q);
+            float car_band_r = svf_bandpass(&v->car_svf_r[b], car_noise_r, f, q);
+            if (whiten) {
+                v->car_env_l[b].acc += car_band_l * car_band_l;
+                v->car_env_r[b].acc += car_band_r * car_band_r;
+            }
+
+            /* Multiply carrier band by modulator envelope */
+            out_l += car_band_l * v->env_out_l[b];
+            out_r += car_band_r * v->env_out_r[b];
+        }
+
+        tick_envelopes(v, det, n);
+
+        v->wet_buf_l[i] = out_l;
+        v->wet_buf_r[i] = out_r;
+    }
+}
+
+/*
+ * Spread: one mono modulator analysis and one mono carrier bank (the L
+ * states), with each band panned by precomputed gains. Roughly half the
+ * filter work of dual, with a wider image.
+ */
+static void vocode_spread(vocoder_instance_t *v, int frames) {
+    int n = v->bands;
+    int det = v->detector;
+    int det_sum = (det == DET_RMS);
+    int quad = (v->run_analysis == ANALYSIS_QUAD);
+    int whiten = (v->whiten > 0.0f);
+    int na = v->active_count;
+    const int *act = v->active_list;
+    int shift = formant_live(v);
+    const float *cf = shift ? v->car_f : v->band_f;
+
+    for (int i = 0; i < frames; i++) {
+        if (shift && !(i & (FORMANT_STEP - 1)))
+            update_formant(v);
+        float mod = 0.5f * (v->mod_buf_l[i] + v->mod_buf_r[i]);
+        float car_noise = 0.5f * (v->car_buf_l[i] + v->car_buf_r[i]);
+
+        for (int b = 0; b < n; b++) {
+            analyze_band(&v->mod_svf_l[b], &v->mod_quad_l[b], &v->mod_env_l[b],
+                         mod, v->band_f[b], v->band_q[b], v->band_quad_k[b], quad, det_sum);
+        }
+
+        float out_l = 0.0f;
+        float out_r = 0.0f;
+
+        for (int j = 0; j < na; j++) {
+            int b = act[j];
+            float car_band = svf_bandpass(&v->car_svf_l[b], car_noise, cf[b], v->band_q[b]);
+            if (whiten)
+                v->car_env_l[b].acc += car_band * car_band;
+
+            float y = car_band * v->env_out_l[b];
+            out_l += y * v->pan_l[b];
+            out_r += y * v->pan_r[b];
+        }
+
+        tick_envelopes(v, det, n);
+
+        v->wet_buf_l[i] = out_l;
+        v->wet_buf_r[i] = out_r;
+    }
+}
+
+/*
+ * Mid/side: one mono modulator analysis drives the full bank on the mid
+ * (the L carrier states) and a bank of grouped bands on the side, then
+ * both decode back to L/R. The pre-pass has already encoded the carrier
+ * buffers to mid and side. Most of the image for little more than spread.
+ */
+static void vocode_ms(vocoder_instance_t *v, int frames) {
+    int n = v->bands;
+    int ns = n >> v->side_shift;
+    int det = v->detector;
+    int det_sum = (det == DET_RMS);
+    int quad = (v->run_analysis == ANALYSIS_QUAD);
+    int whiten = (v->whiten > 0.0f);
+    int na = v->active_count;
+    const int *act = v->active_list;
+    int shift = formant_live(v);
+    const float *cf = shift ? v->car_f : v->band_f;
+    const float *sf = shift ? v->car_side_f : v->side_f;
+
+    for (int i = 0; i < frames; i++) {
+        if (shift && !(i & (FORMANT_STEP - 1)))
+            update_formant(v);
+        float mod = 0.5f * (v->mod_buf_l[i] + v->mod_buf_r[i]);
+        float car_mid = v->car_buf_l[i];
+        float car_side = v->car_buf_r[i];
+
+        for (int b = 0; b < n; b++) {
+            analyze_band(&v->mod_svf_l[b], &v->mod_quad_l[b], &v->mod_env_l[b],
+                         mod, v->band_f[b], v->band_q[b], v->band_quad_k[b], quad, det_sum);
+        }
+
+        float mid = 0.0f;
+        for (int j = 0; j < na; j++) {
+            int b = act[j];
+            float car_band = svf_bandpass(&v->car_svf_l[b], car_mid, cf[b], v->band_q[b]);
+            if (whiten)
+                v->car_env_l[b].acc += car_band * car_band;
+            mid += car_band * v->env_out_l[b];
+        }
+
+        float side = 0.0f;
+        for (int g = 0; g < ns; g++)
+            side += svf_bandpass(&v->side_svf[g], car_side, sf[g], v->side_q[g]) * v->side_env[g];
+
+        tick_envelopes(v, det, n);
+
+        v->wet_buf_l[i] = mid + side;
+        v->wet_buf_r[i] = mid - side;
+    }
+}
+
+/* ── Pitch tracker ───────────────────────────────────────────────────── */
+
+/* Decimate one chunk of mono modulator into the pitch ring. Two one-pole
+ * low-passes at about 2 kHz keep aliasing out of the 60..1000 Hz range. */
+static void pitch_decimate(vocoder_instance_t *v, int frames) {
+    const float a = 0.25f;
+    float lp1 = v->pitch_lp1, lp2 = v->pitch_lp2;
+    int pos = v->pitch_dec_pos;
+    uint32_t w = v->pitch_wpos;
+    for (int i = 0; i < frames; i++) {
+        float x = 0.5f * (v->mod_buf_l[i] + v->mod_buf_r[i]);
+        lp1 += (x - lp1) * a;
+        lp2 += (lp1 - lp2) * a;
+        if (++pos == PITCH_DECIM) {
+            pos = 0;
+            v->pitch_ring[w++ & (PITCH_RING - 1)] = lp2;
+        }
+    }
+    v->pitch_lp1 = lp1;
+    v->pitch_lp2 = lp2;
+    v->pitch_dec_pos = pos;
+    v->pitch_wpos = w;
+}
+
+/* Pick the period from the difference function: cumulative-mean
+ * normalize, take the first dip under PITCH_THRESH (else the deepest),
+ * refine by parabola */
+static void pitch_estimate(vocoder_instance_t *v) {
+    float *d = v->pitch_diff;
+    float sum = 0.0f;
+    float best_val = 2.0f;
+    int best = 0;
+    for (int tau = 1; tau <= PITCH_MAX_LAG; tau++) {
+        sum += d[tau];
+        d[tau] = (sum > 0.0f) ? d[tau] * (float)tau / sum : 1.0f;
+    }
+    for (int tau = PITCH_MIN_LAG; tau <= PITCH_MAX_LAG; tau++) {
+        if (d[tau] < PITCH_THRESH) {
+            while (tau < PITCH_MAX_LAG && d[tau + 1] < d[tau]) tau++;
+            best = tau;
+            best_val = d[tau];
+            break;
+        }
+        if (d[tau] < best_val) {
+            best_val = d[tau];
+            best = tau;
+        }
+    }
+
+    v->pitch_conf = (v->pitch_power > PITCH_MIN_POWER) ? clampf(1.0f - best_val, 0.0f, 1.0f) : 0.0f;
+    if (best_val >= PITCH_THRESH || v->pitch_power <= PITCH_MIN_POWER)
+        return;
 
-typedef struct {
-    /* Parameters */
-    int    bands;         /* 8, 16, 24, or 32 */
-    float  freq_low;      /* Hz */
-    float  freq_high;     /* Hz */
-    float  attack_ms;     /* ms */
-    float  release_ms;    /* ms */
-    float  mod_gain;      /* 0..6 modulator input gain */
-    float  output_gain;   /* 0..6 output gain */
-    float  mix;           /* 0..1 wet/dry */
-    float  carrier_mix;   /* 0..1 noise for unvoiced */
+    float period = (float)best;
+    if (best > PITCH_MIN_LAG && best < PITCH_MAX_LAG) {
+        float a = d[best - 1], b = d[best], c = d[best + 1];
+        float den = a - 2.0f * b + c;
+        if (den > 0.0f) period += clampf(0.5f * (a - c) / den, -0.5f, 0.5f);
+    }
+    v->pitch_hz = (float)PITCH_SR / period;
+}
 
-    /* Derived per-band coefficients */
-    float  band_f[MAX_BANDS];  /* SVF frequency coeff */
-    float  band_q[MAX_BANDS];  /* SVF reciprocal-Q */
-    float  att_coeff;          /* envelope attack */
-    float  rel_coeff;          /* envelope release */
+/* Publish the held pitch to the modulation bus, log-mapped onto 0..1 */
+static void pitch_emit(vocoder_instance_t *v) {
+    if (!g_host->mod_emit_value || !v->pitch_emit_target[0] || !v->pitch_emit_param[0] ||
+        v->pitch_hz <= 0.0f)
+        return;
+    float signal = clampf(log2f(v->pitch_hz / PITCH_MIN_HZ) / log2f(PITCH_MAX_HZ / PITCH_MIN_HZ),
+                          0.0f, 1.0f);
+    g_host->mod_emit_value(g_host->mod_host_ctx, v->mod_source, v->pitch_emit_target,
+                           v->pitch_emit_param, signal, v->pitch_depth, 0.0f, 0, 1);
+    v->pitch_emitted = 1;
+}
 
-    /* Filter states (modulator + carrier, stereo) */
-    svf_state_t mod_svf_l[MAX_BANDS];
-    svf_state_t mod_svf_r[MAX_BANDS];
-    svf_state_t car_svf_l[MAX_BANDS];
-    svf_state_t car_svf_r[MAX_BANDS];
-    env_state_t mod_env_l[MAX_BANDS];
-    env_state_t mod_env_r[MAX_BANDS];
+static void pitch_clear(vocoder_instance_t *v) {
+    if (v->pitch_emitted && g_host->mod_clear_source)
+        g_host->mod_clear_source(g_host->mod_host_ctx, v->mod_source);
+    v->pitch_emitted = 0;
+}
 
-    /* Simple noise state for unvoiced */
-    uint32_t noise_seed;
-} vocoder_instance_t;
+/* Take new modulation target names from the control thread, dropping the
+ * contribution made under the old ones */
+static void poll_pitch_target(vocoder_instance_t *v) {
+    if (atomic_exchange_explicit(&v->pitch_retarget, 0, memory_order_acquire)) {
+        pitch_clear(v);
+        memcpy(v->pitch_emit_target, v->pitch_target, PITCH_ID_LEN);
+        memcpy(v->pitch_emit_param, v->pitch_param, PITCH_ID_LEN);
+    }
+}
 
-static const host_api_v1_t *g_host = NULL;
+/* Per chunk: decimate, then run this chunk's share of lags. The frame is
+ * captured on the first chunk of each estimate and the result published on
+ * the last, so each estimate lags the input by one hop (~23 ms). */
+static void pitch_update(vocoder_instance_t *v, int frames) {
+    pitch_decimate(v, frames);
+
+    const int len = PITCH_WIN + PITCH_MAX_LAG;
+    float *x = v->pitch_frame;
+    if (v->pitch_chunk == 0) {
+        uint32_t start = v->pitch_wpos - (uint32_t)len;
+        float power = 0.0f;
+        for (int j = 0; j < len; j++) {
+            x[j] = v->pitch_ring[(start + (uint32_t)j) & (PITCH_RING - 1)];
+            if (j < PITCH_WIN) power += x[j] * x[j];
+        }
+        v->pitch_power = power / (float)PITCH_WIN;
+    }
 
-/* ── Helpers ─────────────────────────────────────────────────────────── */
+    int per = (PITCH_MAX_LAG + PITCH_HOP_CHUNKS - 1) / PITCH_HOP_CHUNKS;
+    int t0 = 1 + v->pitch_chunk * per;
+    int t1 = clampi(t0 + per - 1, 0, PITCH_MAX_LAG);
+    for (int tau = t0; tau <= t1; tau++) {
+        float s = 0.0f;
+        for (int j = 0; j < PITCH_WIN; j++) {
+            float e = x[j] - x[j + tau];
+            s += e * e;
+        }
+        v->pitch_diff[tau] = s;
+    }
 
-static void voc_log(const char *msg) {
-    if (g_host && g_host->log) {
-        char buf[256];
-        snprintf(buf, sizeof(buf), "[vocoder] %s", msg);
-        g_host->log(buf);
+    if (++v->pitch_chunk == PITCH_HOP_CHUNKS) {
+        v->pitch_chunk = 0;
+        pitch_estimate(v);
+        pitch_emit(v);
     }
 }
 
-/* Simple fast white noise */
-static inline float noise_sample(uint32_t *seed) {
-    *seed = *seed * 1664525u + 1013904223u;
-    return (float)(int32_t)(*seed) / 2147483648.0f;
-}
+/* ── Envelope to MIDI CC ──────────────────────────────────────────── */
 
-/* Recalculate per-band coefficients from current parameters */
-static void recalc_bands(vocoder_instance_t *v) {
-    float log_low  = logf(v->freq_low);
-    float log_high = logf(v->freq_high);
-    int n = v->bands;
+/*
+ * Once per chunk: on each send tick, level every band group (mean gated
+ * envelope power, in dB over CC_FLOOR_DB..0) and queue the groups that
+ * moved past the threshold as one batch of USB-MIDI CC packets. All
+ * packets share a status byte, so a DIN bridge can use running status.
+ * A short write leaves the unsent groups to the next tick, which starts
+ * from the first of them so no group is starved.
+ */
+static void cc_update(vocoder_instance_t *v, int n) {
+    if (v->cc_out == CC_OUT_OFF) return;
+    v->cc_timer -= 1.0f;
+    if (v->cc_timer > 0.0f) return;
+    v->cc_timer += (float)SAMPLE_RATE / ((float)MAX_BLOCK * v->cc_rate);
+
+    int groups = v->cc_groups;
+    int dual = (v->stereo == STEREO_DUAL);
+    uint8_t status = (uint8_t)(0xB0 | (v->cc_channel - 1));
+    uint8_t pkt[CC_MAX_GROUPS * 4];
+    int idx[CC_MAX_GROUPS], val[CC_MAX_GROUPS];
+    int count = 0;
+
+    for (int k = 0; k < groups; k++) {
+        int g = (v->cc_first + k) % groups;
+        int b0 = g * n / groups, b1 = (g + 1) * n / groups;
+        float power = 0.0f;
+        for (int b = b0; b < b1; b++) {
+            float l = fmaxf(v->env_amp_l[b] - v->gate_sub_l[b], 0.0f);
+            float r = dual ? fmaxf(v->env_amp_r[b] - v->gate_sub_r[b], 0.0f) : l;
+            power += 0.5f * (l * l + r * r);
+        }
+        power /= (float)(b1 - b0);
+        float db = 3.0103f * fast_log2(power + 1e-12f);  /* 10 log10 */
+        int cc_val = clampi((int)((db - CC_FLOOR_DB) * (127.0f / -CC_FLOOR_DB)), 0, 127);
+
+        int last = v->cc_sent[g];
+        if (last >= 0 && abs(cc_val - last) < v->cc_thresh &&
+            !(cc_val == 0 && last != 0) && !(cc_val == 127 && last != 127))
+            continue;
+        uint8_t *p = &pkt[count * 4];
+        p[0] = 0x0B;  /* cable 0, CIN control change */
+        p[1] = status;
+        p[2] = (uint8_t)(v->cc_base + g);
+        p[3] = (uint8_t)cc_val;
+        idx[count] = g;
+        val[count] = cc_val;
+        count++;
+    }
+    if (count == 0) return;
+
+    int len = count * 4;
+    int sent = len;
+    if (v->cc_out == CC_OUT_INTERNAL || v->cc_out == CC_OUT_BOTH)
+        sent = g_host->midi_send_internal ? g_host->midi_send_internal(pkt, len) : 0;
+    if (v->cc_out == CC_OUT_EXTERNAL || v->cc_out == CC_OUT_BOTH) {
+        int ext = g_host->midi_send_external ? g_host->midi_send_external(pkt, len) : 0;
+        sent = (v->cc_out == CC_OUT_BOTH) ? (sent < ext ? sent : ext) : ext;
+    }
+    int k = 0;
+    for (; k < count && (k + 1) * 4 <= sent; k++)
+        v->cc_sent[idx[k]] = val[k];
+    v->cc_first = (k < count) ? idx[k] : 0;
+}
 
-    for (int i = 0; i < n; i++) {
-        /* Logarithmically spaced center frequencies */
-        float t = (n > 1) ? (float)i / (float)(n - 1) : 0.5f;
-        float fc = expf(log_low + t * (log_high - log_low));
+/* ── DSP snapshots ───────────────────────────────────────────────────── */
 
-        /* SVF frequency coefficient: 2 * sin(pi * fc / sr) */
-        float f = 2.0f * sinf((float)M_PI * fc / (float)SAMPLE_RATE);
-        /* Clamp to avoid instability */
-        if (f > 1.0f) f = 1.0f;
-        v->band_f[i] = f;
+/*
+ * Binary snapshot: a SNAP_HEADER header (magic, version, band count,
+ * state JSON length), the state JSON for the parameters, then the memory
+ * section below in native (little-endian) float layout. The memory
+ * section holds every filter and envelope memory, the coefficients that
+ * cannot be rederived from parameters (adaptive placement, a glide in
+ * progress) and the counters that phase the control-rate updates, so a
+ * restored instance continues exactly where the snapshot was taken. Delay
+ * lines and the pitch tracker are not included; they refill within 50 ms.
+ * Carried over the text param API as base64.
+ */
+typedef struct {
+    uint8_t *p;
+    int     pos;
+    int     cap;
+    int     reading;  /* 1: copy buffer -> instance, 0: instance -> buffer */
+    int     ok;
+    int     check;    /* 1: only verify the buffer's floats are finite */
+} snapshot_io_t;
+
+static void snapshot_field(snapshot_io_t *io, void *field, int size) {
+    if (!io->ok || io->pos + size > io->cap) {
+        io->ok = 0;
+        return;
+    }
+    if (io->p && !io->check) {
+        if (io->reading) memcpy(field, io->p + io->pos, size);
+        else memcpy(io->p + io->pos, field, size);
+    }
+    io->pos += size;
+}
 
-        /* Q proportional to band spacing — wider bands at low count */
-        /* Q ~ sqrt(n) gives decent overlap */
-        float Q = 1.0f + 0.5f * sqrtf((float)n);
-        v->band_q[i] = 1.0f / Q;
+/* count floats; a check walk fails on any NaN or infinity in the buffer */
+static void snapshot_floats(snapshot_io_t *io, float *field, int count) {
+    int size = (int)sizeof(float) * count;
+    if (io->ok && io->check && io->p && io->pos + size <= io->cap) {
+        for (int i = 0; i < count; i++) {
+            float x;
+            memcpy(&x, io->p + io->pos + (int)sizeof(float) * i, sizeof(float));
+            if (!isfinite(x)) {
+                io->ok = 0;
+                return;
+            }
+        }
     }
+    snapshot_field(io, field, size);
+}
 
-    /* Envelope coefficients from time constants */
-    float att_ms = v->attack_ms;
-    float rel_ms = v->release_ms;
-    if (att_ms < 0.1f) att_ms = 0.1f;
-    if (rel_ms < 0.1f) rel_ms = 0.1f;
-    v->att_coeff = 1.0f - expf(-1.0f / (att_ms * 0.001f * (float)SAMPLE_RATE));
-    v->rel_coeff = 1.0f - expf(-1.0f / (rel_ms * 0.001f * (float)SAMPLE_RATE));
+/* An array of n all-float structs (or plain floats) */
+#define SNAP_FLOATS(io, arr, n) \
+    snapshot_floats((io), (float *)(arr), (int)(sizeof(*(arr)) / sizeof(float)) * (n))
+
+/* Field by field, so the floats are checked; same bytes as the struct */
+static void snapshot_layout(snapshot_io_t *io, band_layout_t *L) {
+    snapshot_field(io, &L->valid, sizeof(int));
+    snapshot_field(io, &L->scale, sizeof(int));
+    snapshot_field(io, &L->bands, sizeof(int));
+    SNAP_FLOATS(io, &L->freq_low, 1);
+    SNAP_FLOATS(io, &L->freq_high, 1);
+    SNAP_FLOATS(io, L->fc, MAX_BANDS);
+    SNAP_FLOATS(io, L->f, MAX_BANDS);
+    SNAP_FLOATS(io, L->q, MAX_BANDS);
+    SNAP_FLOATS(io, L->norm, MAX_BANDS);
 }
 
-/* Clear all filter states */
-static void clear_filters(vocoder_instance_t *v) {
-    memset(v->mod_svf_l, 0, sizeof(v->mod_svf_l));
-    memset(v->mod_svf_r, 0, sizeof(v->mod_svf_r));
-    memset(v->car_svf_l, 0, sizeof(v->car_svf_l));
-    memset(v->car_svf_r, 0, sizeof(v->car_svf_r));
-    memset(v->mod_env_l, 0, sizeof(v->mod_env_l));
-    memset(v->mod_env_r, 0, sizeof(v->mod_env_r));
+/* The memory section for n bands; the same walk writes and reads it, and
+ * with no buffer only measures it */
+static void snapshot_memory(vocoder_instance_t *v, int n, snapshot_io_t *io) {
+    SNAP_FLOATS(io, v->band_f, n);
+    SNAP_FLOATS(io, v->band_q, n);
+    snapshot_field(io, &v->adapt_glide, sizeof(int));
+    snapshot_layout(io, &v->adapt_layout);
+
+    SNAP_FLOATS(io, v->mod_svf_l, n);
+    SNAP_FLOATS(io, v->mod_svf_r, n);
+    SNAP_FLOATS(io, v->car_svf_l, n);
+    SNAP_FLOATS(io, v->car_svf_r, n);
+    SNAP_FLOATS(io, v->side_svf, n);
+    SNAP_FLOATS(io, v->side_env, n);
+    SNAP_FLOATS(io, v->mod_quad_l, n);
+    SNAP_FLOATS(io, v->mod_quad_r, n);
+    SNAP_FLOATS(io, v->mod_env_l, n);
+    SNAP_FLOATS(io, v->mod_env_r, n);
+    SNAP_FLOATS(io, v->car_env_l, n);
+    SNAP_FLOATS(io, v->car_env_r, n);
+    SNAP_FLOATS(io, v->env_amp_l, n);
+    SNAP_FLOATS(io, v->env_amp_r, n);
+    SNAP_FLOATS(io, v->env_out_l, n);
+    SNAP_FLOATS(io, v->env_out_r, n);
+    snapshot_field(io, &v->env_phase, sizeof(uint32_t));
+
+    SNAP_FLOATS(io, v->nf_min_l, n);
+    SNAP_FLOATS(io, v->nf_min_r, n);
+    for (int w = 0; w < NF_WINDOWS; w++) {
+        SNAP_FLOATS(io, v->nf_hist_l[w], n);
+        SNAP_FLOATS(io, v->nf_hist_r[w], n);
+    }
+    SNAP_FLOATS(io, v->gate_sub_l, n);
+    SNAP_FLOATS(io, v->gate_sub_r, n);
+    snapshot_field(io, &v->nf_count, sizeof(int));
+    snapshot_field(io, &v->nf_slot, sizeof(int));
+    snapshot_field(io, v->band_active, n);
+    snapshot_field(io, v->active_list, (int)sizeof(int) * n);
+    snapshot_field(io, &v->active_count, sizeof(int));
+
+    SNAP_FLOATS(io, &v->mod_pre_l, 1);
+    SNAP_FLOATS(io, &v->mod_pre_r, 1);
+    SNAP_FLOATS(io, &v->air_pre_l, 1);
+    SNAP_FLOATS(io, &v->air_pre_r, 1);
+    SNAP_FLOATS(io, &v->air_noise, 1);
+    SNAP_FLOATS(io, &v->air_env_l, 1);
+    SNAP_FLOATS(io, &v->air_env_r, 1);
+    SNAP_FLOATS(io, &v->agc_gain_db, 1);
+    SNAP_FLOATS(io, &v->agc_gain_lin, 1);
+    SNAP_FLOATS(io, &v->input_level_db, 1);
+    snapshot_field(io, &v->noise_seed, sizeof(uint32_t));
+    SNAP_FLOATS(io, &v->formant_cur, 1);
+    SNAP_FLOATS(io, &v->sweep_phase, 1);
 }
 
-/* Simple JSON float extraction */
-static int json_get_float(const char *json, const char *key, float *out) {
-    char search[64];
-    snprintf(search, sizeof(search), "\"%s\":", key);
-    const char *p = strstr(json, search);
-    if (!p) return -1;
-    p += strlen(search);
-    while (*p == ' ' || *p == '\t') p++;
-    *out = (float)atof(p);
-    return 0;
+/* Exact size of the memory section for n bands */
+static int snapshot_memory_size(vocoder_instance_t *v, int n) {
+    snapshot_io_t io = { NULL, 0, SNAP_MAX_BYTES, 0, 1, 0 };
+    snapshot_memory(v, n, &io);
+    return io.ok ? io.pos : -1;
 }
 
-static int json_get_int(const char *json, const char *key, int *out) {
-    char search[64];
-    snprintf(search, sizeof(search), "\"%s\":", key);
-    const char *p = strstr(json, search);
-    if (!p) return -1;
-    p += strlen(search);
-    while (*p == ' ' || *p == '\t') p++;
-    *out = atoi(p);
-    return 0;
+static const char g_b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Returns the encoded length, or -1 if out is too small */
+static int b64_encode(const uint8_t *in, int len, char *out, int out_len) {
+    int need = (len + 2) / 3 * 4;
+    if (need >= out_len) return -1;
+    int o = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t x = (uint32_t)in[i] << 16;
+        if (i + 1 < len) x |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) x |= in[i + 2];
+        out[o++] = g_b64[(x >> 18) & 63];
+        out[o++] = g_b64[(x >> 12) & 63];
+        out[o++] = (i + 1 < len) ? g_b64[(x >> 6) & 63] : '=';
+        out[o++] = (i + 2 < len) ? g_b64[x & 63] : '=';
+    }
+    out[o] = '\0';
+    return o;
 }
 
-/* Clamp helpers */
-static inline float clampf(float x, float lo, float hi) {
-    if (x < lo) return lo;
-    if (x > hi) return hi;
-    return x;
+/* Returns the decoded length, or -1 on bad input or overflow */
+static int b64_decode(const char *in, uint8_t *out, int out_len) {
+    uint32_t x = 0;
+    int bits = 0, o = 0;
+    for (; *in && *in != '='; in++) {
+        const char *c = strchr(g_b64, *in);
+        if (!c || !*in) return -1;
+        x = (x << 6) | (uint32_t)(c - g_b64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (o >= out_len) return -1;
+            out[o++] = (uint8_t)(x >> bits);
+        }
+    }
+    return o;
 }
 
-static inline int clampi(int x, int lo, int hi) {
-    if (x < lo) return lo;
-    if (x > hi) return hi;
-    return x;
+static void snapshot_put_u16(uint8_t *p, int x) {
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
 }
 
-/* Snap band count to nearest valid value */
-static int snap_bands(int v) {
-    if (v <= 12) return 8;
-    if (v <= 20) return 16;
-    if (v <= 28) return 24;
-    return 32;
+static int snapshot_get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
 }
 
-/* ── V2 API ──────────────────────────────────────────────────────────── */
+/* Serialize the instance with the given state JSON; returns base64 length or -1 */
+static int snapshot_encode(vocoder_instance_t *v, const char *state, char *out, int out_len) {
+    uint8_t *bin = (uint8_t *)malloc(SNAP_MAX_BYTES);
+    if (!bin) return -1;
+
+    int json_len = (int)strlen(state);
+    uint32_t magic = SNAP_MAGIC;
+    memcpy(bin, &magic, 4);
+    snapshot_put_u16(bin + 4, SNAP_VERSION);
+    snapshot_put_u16(bin + 6, v->bands);
+    snapshot_put_u16(bin + 8, json_len);
+    snapshot_put_u16(bin + 10, 0);
+    memcpy(bin + SNAP_HEADER, state, json_len);
+
+    snapshot_io_t io = { bin, SNAP_HEADER + json_len, SNAP_MAX_BYTES, 0, 1, 0 };
+    snapshot_memory(v, v->bands, &io);
+    int len = io.ok ? b64_encode(bin, io.pos, out, out_len) : -1;
+    free(bin);
+    return len;
+}
 
-static void* v2_create_instance(const char *module_dir, const char *config_json) {
-    (void)module_dir;
-    (void)config_json;
+/* Control thread: decode and check a snapshot, returning its state JSON
+ * in state (the caller applies it); the memory section, which must be
+ * exactly the size written for the snapshot's band count and hold only
+ * finite floats, waits in snap_buf for the audio thread */
+static int snapshot_decode(vocoder_instance_t *v, const char *val, char *state) {
+    if (atomic_load_explicit(&v->snap_ready, memory_order_acquire)) {
+        voc_log("Snapshot restore already pending");
+        return -1;
+    }
+    int len = b64_decode(val, v->snap_buf, SNAP_MAX_BYTES);
+    if (len < SNAP_HEADER) return -1;
+
+    uint32_t magic;
+    memcpy(&magic, v->snap_buf, 4);
+    int version = snapshot_get_u16(v->snap_buf + 4);
+    int bands = snapshot_get_u16(v->snap_buf + 6);
+    int json_len = snapshot_get_u16(v->snap_buf + 8);
+    if (magic != SNAP_MAGIC || version != SNAP_VERSION) {
+        voc_log("Snapshot has an unknown format or version");
+        return -1;
+    }
+    if (bands != snap_bands(clampi(bands, 8, 32)) || json_len >= SNAP_STATE_MAX)
+        return -1;
+    int mem = snapshot_memory_size(v, bands);
+    if (mem < 0 || SNAP_HEADER + json_len + mem != len)
+        return -1;
+    snapshot_io_t io = { v->snap_buf, SNAP_HEADER + json_len, len, 1, 1, 1 };
+    snapshot_memory(v, bands, &io);
+    if (!io.ok) {
+        voc_log("Snapshot holds non-finite values");
+        return -1;
+    }
 
-    voc_log("Creating instance");
+    memcpy(state, v->snap_buf + SNAP_HEADER, json_len);
+    state[json_len] = '\0';
+    v->snap_len = len;
+    v->snap_offset = SNAP_HEADER + json_len;
+    v->snap_band_count = bands;
+    return bands;
+}
 
-    vocoder_instance_t *v = (vocoder_instance_t *)calloc(1, sizeof(vocoder_instance_t));
-    if (!v) {
-        voc_log("Failed to allocate instance");
-        return NULL;
+/* Audio thread: copy in a pending snapshot's memories at a chunk boundary.
+ * A band change since the restore leaves them for another layout, so they
+ * are dropped, as is a section that is not exactly the band count's size;
+ * indices are clamped so a damaged snapshot cannot index past the band
+ * arrays. A restored adaptive placement replaces the one the state JSON
+ * was applied with, so everything derived from it is recomputed around
+ * the restored filter coefficients; a glide is only resumed toward a
+ * placement that matches the current settings */
+static void poll_snapshot(vocoder_instance_t *v) {
+    if (!atomic_load_explicit(&v->snap_ready, memory_order_acquire))
+        return;
+    int n = v->bands;
+    if (v->snap_band_count == n &&
+        v->snap_len - v->snap_offset == snapshot_memory_size(v, n)) {
+        snapshot_io_t io = { v->snap_buf, v->snap_offset, v->snap_len, 1, 1, 0 };
+        snapshot_memory(v, n, &io);
+        v->nf_count = clampi(v->nf_count, 0, NF_SUBWIN - 1);
+        v->nf_slot = clampi(v->nf_slot, 0, NF_WINDOWS - 1);
+        v->active_count = clampi(v->active_count, 0, n);
+        for (int i = 0; i < v->active_count; i++)
+            v->active_list[i] = clampi(v->active_list[i], 0, n - 1);
+
+        const band_layout_t *L = &v->adapt_layout;
+        if (v->scale == SCALE_ADAPTIVE && L->valid && L->bands == n &&
+            L->freq_low == v->freq_low && L->freq_high == v->freq_high) {
+            int glide = clampi(v->adapt_glide, 0, ADAPT_GLIDE);
+            rederive_keep_filters(v);
+            v->adapt_glide = glide;
+        } else {
+            v->adapt_glide = 0;
+        }
     }
+    atomic_store_explicit(&v->snap_ready, 0, memory_order_release);
+}
 
-    /* Defaults */
-    v->bands       = 16;
-    v->freq_low    = 100.0f;
-    v->freq_high   = 8000.0f;
-    v->attack_ms   = 5.0f;
-    v->release_ms  = 50.0f;
-    v->mod_gain    = 2.0f;
-    v->output_gain = 2.0f;
-    v->mix         = 1.0f;
-    v->carrier_mix = 0.1f;
-    v->noise_seed  = 12345;
+/*
+ * Fold one measured block into the profile and the cost calibration. Each
+ * sample's pull on ns_per_unit is limited to a factor of two, so a block
+ * stretched by preemption barely moves it while a wrong starting scale
+ * still converges within a few hundred blocks.
+ */
+static void profile_block(vocoder_instance_t *v, float ns, float units) {
+    if (units > 0.0f) {
+        float r = clampf(ns / units, 0.5f * v->ns_per_unit, 2.0f * v->ns_per_unit);
+        v->ns_per_unit += (r - v->ns_per_unit) * COST_CAL_RATE;
+    }
+    v->block_ns_avg += (ns - v->block_ns_avg) * COST_CAL_RATE;
+    v->block_ns_max = fmaxf(ns, v->block_ns_max * COST_PEAK_DECAY);
+}
 
-    recalc_bands(v);
+/* Change the degrade level, resetting state the switch leaves stale */
+static void set_cpu_level(vocoder_instance_t *v, int level) {
+    if (level < CPU_LEVEL_REAL && v->cpu_level >= CPU_LEVEL_REAL) {
+        memset(v->mod_quad_l, 0, sizeof(v->mod_quad_l));
+        memset(v->mod_quad_r, 0, sizeof(v->mod_quad_r));
+    }
+    if (level < CPU_LEVEL_MONO && v->cpu_level >= CPU_LEVEL_MONO) {
+        memcpy(v->mod_svf_r, v->mod_svf_l, sizeof(v->mod_svf_r));
+        memcpy(v->mod_env_r, v->mod_env_l, sizeof(v->mod_env_r));
+    }
+    v->cpu_level = level;
+    apply_cpu_level(v);
+}
 
-    voc_log("Instance created");
-    return v;
+/* Levels past this one change nothing for the current settings */
+static int max_cpu_level(const vocoder_instance_t *v) {
+    if (v->stereo == STEREO_DUAL) return CPU_LEVEL_MONO;
+    if (v->analysis == ANALYSIS_QUAD) return CPU_LEVEL_REAL;
+    return CPU_LEVEL_COARSE;
 }
 
-static void v2_destroy_instance(void *instance) {
-    vocoder_instance_t *v = (vocoder_instance_t *)instance;
-    if (!v) return;
-    voc_log("Destroying instance");
-    free(v);
+/* Publish this block's cost and take a level step if this instance is the one to act */
+static void coord_update(vocoder_instance_t *v, uint32_t now_ms) {
+    int me = v->coord_slot;
+    if (me < 0) return;
+
+    coord_slot_t *slots = g_coord_slots;
+    int level = v->cpu_level;
+    atomic_store(&slots[me].cost_ns, (int)v->block_ns_avg);
+    atomic_store(&slots[me].priority, v->priority);
+    atomic_store(&slots[me].level, level);
+    atomic_store(&slots[me].max_level, max_cpu_level(v));
+
+    unsigned next = atomic_load(&g_coord_next_ms);
+    if ((int32_t)(now_ms - next) < 0) return;
+
+    float total = 0.0f;
+    int degrade = -1, degrade_pri = 0, degrade_cost = 0;
+    int restore = -1, restore_pri = 0, restore_cost = 0;
+    for (int i = 0; i < COORD_SLOTS; i++) {
+        if (!atomic_load(&slots[i].used)) continue;
+        int cost = atomic_load(&slots[i].cost_ns);
+        int pri = atomic_load(&slots[i].priority);
+        int lvl = atomic_load(&slots[i].level);
+        total += (float)cost;
+
+        if (lvl < atomic_load(&slots[i].max_level) && (degrade < 0 || pri < degrade_pri ||
+                     (pri == degrade_pri && cost >= degrade_cost))) {
+            degrade = i; degrade_pri = pri; degrade_cost = cost;
+        }
+        if (lvl > CPU_LEVEL_FULL && (restore < 0 || pri > restore_pri ||
+                                     (pri == restore_pri && cost <= restore_cost))) {
+            restore = i; restore_pri = pri; restore_cost = cost;
+        }
+    }
+
+    float budget = (float)atomic_load(&g_coord_budget_pct) * 0.01f
+                 * 1e9f * (float)MAX_BLOCK / (float)SAMPLE_RATE;
+    int step = 0;
+    if (total > budget && degrade == me) step = 1;
+    else if (total < budget * COORD_RECOVER && restore == me) step = -1;
+    if (step && atomic_compare_exchange_strong(&g_coord_next_ms, &next, now_ms + COORD_HOLD_MS))
+        set_cpu_level(v, level + step);
 }
 
 static void v2_process_block(void *instance, int16_t *audio_inout, int frames) {
     vocoder_instance_t *v = (vocoder_instance_t *)instance;
     if (!v || !g_host) return;
+    pthread_mutex_lock(&v->lock);
 
     int n = v->bands;
 
     /* Read modulator from hardware audio input buffer */
     int16_t *mic_in = (int16_t *)(g_host->mapped_memory + g_host->audio_in_offset);
 
-    float att = v->att_coeff;
-    float rel = v->rel_coeff;
-    float mod_gain = v->mod_gain;
     float out_gain = v->output_gain;
     float wet = v->mix;
     float dry = 1.0f - wet;
-    float noise_mix = v->carrier_mix;
-
-    for (int i = 0; i < frames; i++) {
-        /* Convert carrier (synth output) to float */
-        float car_l = audio_inout[i * 2]     / 32768.0f;
-        float car_r = audio_inout[i * 2 + 1] / 32768.0f;
-
-        /* Convert modulator (mic input) to float with gain */
-        float mod_l = mic_in[i * 2]     / 32768.0f * mod_gain;
-        float mod_r = mic_in[i * 2 + 1] / 32768.0f * mod_gain;
-
-        /* Add noise to carrier for unvoiced/consonant content */
-        float ns = noise_sample(&v->noise_seed);
-        float car_noise_l = car_l + ns * noise_mix;
-        float car_noise_r = car_r + ns * noise_mix;
-
-        /* Accumulate vocoded output across bands */
-        float out_l = 0.0f;
-        float out_r = 0.0f;
-
-        for (int b = 0; b < n; b++) {
-            float f = v->band_f[b];
-            float q = v->band_q[b];
 
-            /* Filter modulator through bandpass → envelope */
-            float mod_band_l = svf_bandpass(&v->mod_svf_l[b], mod_l, f, q);
-            float mod_band_r = svf_bandpass(&v->mod_svf_r[b], mod_r, f, q);
-            float env_l = env_follow(&v->mod_env_l[b], mod_band_l, att, rel);
-            float env_r = env_follow(&v->mod_env_r[b], mod_band_r, att, rel);
+    /* Scale output (more bands = more energy), apply output gain and mix */
+    float scale = 2.0f / sqrtf((float)n) * out_gain * wet;
+    float air_gain = v->air * AIR_GAIN * out_gain * wet;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    float units = 0.0f;
+    float pitch_ns = 0.0f;
+
+    for (int offset = 0; offset < frames; offset += MAX_BLOCK) {
+        int len = frames - offset;
+        if (len > MAX_BLOCK) len = MAX_BLOCK;
+        int16_t *io = audio_inout + offset * 2;
+
+        poll_align(v);
+        poll_adapt_layout(v);
+        poll_pitch_target(v);
+        poll_snapshot(v);
+        glide_layout(v);
+        prepare_inputs(v, io, mic_in + offset * 2, len);
+        record_align(v, len);
+        apply_delays(v, len);
+        if (v->pitch_track) {
+            struct timespec p0, p1;
+            clock_gettime(CLOCK_MONOTONIC, &p0);
+            pitch_update(v, len);
+            clock_gettime(CLOCK_MONOTONIC, &p1);
+            pitch_ns += (float)(p1.tv_sec - p0.tv_sec) * 1e9f + (float)(p1.tv_nsec - p0.tv_nsec);
+        }
+        update_noise_floor(v, n);
+        update_active_bands(v, n);
+        units += (v->cost_fixed + (float)v->active_count * v->cost_band) * (float)len;
+
+        if (v->stereo == STEREO_SPREAD)
+            vocode_spread(v, len);
+        else if (v->stereo == STEREO_MS)
+            vocode_ms(v, len);
+        else
+            vocode_dual(v, len);
+        record_adapt(v, n);
+        cc_update(v, n);
+
+        for (int i = 0; i < len; i++) {
+            /* Wet/dry mix */
+            float mix_l = v->wet_buf_l[i] * scale + v->air_buf_l[i] * air_gain +
+                          v->dry_buf_l[i] * dry;
+            float mix_r = v->wet_buf_r[i] * scale + v->air_buf_r[i] * air_gain +
+                          v->dry_buf_r[i] * dry;
+
+            /* Clamp and write back */
+            mix_l = clampf(mix_l, -1.0f, 1.0f);
+            mix_r = clampf(mix_r, -1.0f, 1.0f);
+
+            io[i * 2]     = (int16_t)(mix_l * 32767.0f);
+            io[i * 2 + 1] = (int16_t)(mix_r * 32767.0f);
+        }
+    }
 
-            /* Filter carrier through same bandpass */
-            float car_band_l = svf_bandpass(&v->car_svf_l[b], car_noise_l, f, q);
-            float car_band_r = svf_bandpass(&v->car_svf_r[b], car_noise_r, f, q);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (v->pitch_track)
+        v->pitch_ns += (pitch_ns - v->pitch_ns) * COST_CAL_RATE;
+    float ns = (float)(t1.tv_sec - t0.tv_sec) * 1e9f + (float)(t1.tv_nsec - t0.tv_nsec);
+    profile_block(v, ns, units);
+    coord_update(v, (uint32_t)t1.tv_sec * 1000u + (uint32_t)(t1.tv_nsec / 1000000));
+    pthread_mutex_unlock(&v->lock);
+}
 
-            /* Multiply carrier band by modulator envelope */
-            out_l += car_band_l * env_l;
-            out_r += car_band_r * env_r;
-        }
+/* Parse a "g0,g1,..." dB list into the user curve; missing points are 0 dB */
+static void set_curve(vocoder_instance_t *v, const char *val) {
+    float pts[CURVE_POINTS] = { 0 };
+    parse_float_list(val, pts, CURVE_POINTS);
+    for (int i = 0; i < CURVE_POINTS; i++)
+        v->curve[i] = clampf(pts[i], -24.0f, 24.0f);
+}
 
-        /* Scale output (more bands = more energy), apply output gain */
-        float scale = 2.0f / sqrtf((float)n) * out_gain;
-        out_l *= scale;
-        out_r *= scale;
+/* Whether the current settings are exactly those of a tier */
+static int tier_matches(const vocoder_instance_t *v, int quality) {
+    const quality_tier_t *t = &g_quality_tiers[quality];
+    return quality != QUALITY_CUSTOM && t->engine == v->engine && t->bands == v->bands &&
+           t->analysis == v->analysis && t->env_rate == v->env_rate && t->stereo == v->stereo;
+}
 
-        /* Wet/dry mix */
-        float mix_l = out_l * wet + car_l * dry;
-        float mix_r = out_r * wet + car_r * dry;
+/* Label restored settings: the saved tier if they still match it, else the
+ * first tier they match (patches saved before tiers), else Custom */
+static int restored_quality(const vocoder_instance_t *v, int saved) {
+    if (saved >= 0)
+        return tier_matches(v, saved) ? saved : QUALITY_CUSTOM;
+    for (int q = 0; q < QUALITY_COUNT; q++)
+        if (tier_matches(v, q)) return q;
+    return QUALITY_CUSTOM;
+}
 
-        /* Clamp and write back */
-        mix_l = clampf(mix_l, -1.0f, 1.0f);
-        mix_r = clampf(mix_r, -1.0f, 1.0f);
+/* Switch to a quality tier, resetting only the state its changes invalidate */
+static void apply_quality(vocoder_instance_t *v, int quality) {
+    v->quality = quality;
+    if (quality == QUALITY_CUSTOM) return;
 
-        audio_inout[i * 2]     = (int16_t)(mix_l * 32767.0f);
-        audio_inout[i * 2 + 1] = (int16_t)(mix_r * 32767.0f);
+    const quality_tier_t *t = &g_quality_tiers[quality];
+    if (t->bands != v->bands || t->stereo != v->stereo)
+        clear_filters(v);
+    if (t->analysis != v->analysis) {
+        memset(v->mod_quad_l, 0, sizeof(v->mod_quad_l));
+        memset(v->mod_quad_r, 0, sizeof(v->mod_quad_r));
     }
+    v->engine = t->engine;
+    v->bands = t->bands;
+    v->analysis = t->analysis;
+    v->env_rate = t->env_rate;
+    v->stereo = t->stereo;
+    recalc_bands(v);
 }
 
-static void v2_set_param(void *instance, const char *key, const char *val) {
-    vocoder_instance_t *v = (vocoder_instance_t *)instance;
-    if (!v) return;
-
+/* Control-thread parameter handling; callers hold v->lock. param_version
+ * moves only for keys that are part of the state, so unknown keys,
+ * requests and module-level settings keep the cached state. */
+static void set_param(vocoder_instance_t *v, const char *key, const char *val) {
     /* State restore from patch save */
     if (strcmp(key, "state") == 0) {
         int iv;
@@ -341,9 +3061,111 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
             v->mix = clampf(fv, 0.0f, 1.0f);
         if (json_get_float(val, "carrier_mix", &fv) == 0)
             v->carrier_mix = clampf(fv, 0.0f, 1.0f);
+        if (json_get_int(val, "scale", &iv) == 0) {
+            v->scale = clampi(iv, 0, SCALE_COUNT - 1);
+            if (v->scale == SCALE_ADAPTIVE) worker_start(v);
+        }
+        if (json_get_float(val, "env_scale", &fv) == 0)
+            v->env_scale = clampf(fv, 0.25f, 4.0f);
+        if (json_get_int(val, "detector", &iv) == 0)
+            v->detector = clampi(iv, 0, DET_COUNT - 1);
+        if (json_get_int(val, "analysis", &iv) == 0)
+            v->analysis = clampi(iv, 0, ANALYSIS_COUNT - 1);
+        if (json_get_int(val, "dc_block", &iv) == 0)
+            v->dc_block = iv ? 1 : 0;
+        if (json_get_float(val, "mod_hpf", &fv) == 0)
+            v->mod_hpf = clampf(fv, 0.0f, 300.0f);
+        if (json_get_float(val, "pre_emph", &fv) == 0)
+            v->pre_emph = clampf(fv, 0.0f, 0.95f);
+        if (json_get_float(val, "whiten", &fv) == 0)
+            v->whiten = clampf(fv, 0.0f, 1.0f);
+        if (json_get_int(val, "agc", &iv) == 0)
+            v->agc = iv ? 1 : 0;
+        if (json_get_float(val, "gate", &fv) == 0)
+            v->gate = clampf(fv, 0.0f, 1.0f);
+        if (json_get_float(val, "align", &fv) == 0)
+            v->align_ms = clampf(fv, -ALIGN_MAX_MS, ALIGN_MAX_MS);
+        if (json_get_float(val, "tilt", &fv) == 0)
+            v->tilt = clampf(fv, -6.0f, 6.0f);
+        if (json_get_float(val, "presence", &fv) == 0)
+            v->presence = clampf(fv, 0.0f, 12.0f);
+        char sv[128];
+        if (json_get_string(val, "curve", sv, sizeof(sv)) == 0)
+            set_curve(v, sv);
+        if (json_get_int(val, "stereo", &iv) == 0)
+            v->stereo = clampi(iv, 0, STEREO_COUNT - 1);
+        if (json_get_int(val, "pan_mode", &iv) == 0)
+            v->pan_mode = clampi(iv, 0, PAN_COUNT - 1);
+        if (json_get_float(val, "width", &fv) == 0)
+            v->width = clampf(fv, 0.0f, 1.0f);
+        if (json_get_float(val, "agc_target", &fv) == 0)
+            v->agc_target = clampf(fv, -40.0f, -6.0f);
+        if (json_get_float(val, "agc_max", &fv) == 0)
+            v->agc_max = clampf(fv, 0.0f, 40.0f);
+        if (json_get_float(val, "agc_attack", &fv) == 0)
+            v->agc_attack_ms = clampf(fv, 10.0f, 1000.0f);
+        if (json_get_float(val, "agc_release", &fv) == 0)
+            v->agc_release_ms = clampf(fv, 50.0f, 5000.0f);
+        if (json_get_int(val, "env_rate", &iv) == 0)
+            v->env_rate = clampi(iv, 0, ENV_RATE_COUNT - 1);
+        if (json_get_int(val, "priority", &iv) == 0)
+            v->priority = clampi(iv, 0, PRIORITY_COUNT - 1);
+        if (json_get_int(val, "pitch_track", &iv) == 0)
+            v->pitch_track = iv ? 1 : 0;
+        if (json_get_float(val, "pitch_depth", &fv) == 0)
+            v->pitch_depth = clampf(fv, 0.0f, 1.0f);
+        if (json_get_string(val, "pitch_target", sv, sizeof(sv)) == 0)
+            copy_ident(v->pitch_target, sv, PITCH_ID_LEN);
+        if (json_get_string(val, "pitch_param", sv, sizeof(sv)) == 0)
+            copy_ident(v->pitch_param, sv, PITCH_ID_LEN);
+        atomic_store_explicit(&v->pitch_retarget, 1, memory_order_release);
+        if (json_get_int(val, "cc_out", &iv) == 0)
+            v->cc_out = clampi(iv, 0, CC_OUT_COUNT - 1);
+        if (json_get_int(val, "cc_groups", &iv) == 0)
+            v->cc_groups = clampi(iv, 2, CC_MAX_GROUPS);
+        if (json_get_int(val, "cc_base", &iv) == 0)
+            v->cc_base = iv;
+        v->cc_base = clampi(v->cc_base, 0, 120 - v->cc_groups);
+        if (json_get_int(val, "cc_channel", &iv) == 0)
+            v->cc_channel = clampi(iv, 1, 16);
+        if (json_get_float(val, "cc_rate", &fv) == 0)
+            v->cc_rate = clampf(fv, 5.0f, 100.0f);
+        if (json_get_int(val, "cc_thresh", &iv) == 0)
+            v->cc_thresh = clampi(iv, 1, 16);
+        if (json_get_int(val, "side_bands", &iv) == 0)
+            v->side_bands = clampi(iv, 0, SIDE_COUNT - 1);
+        if (json_get_float(val, "formant", &fv) == 0)
+            v->formant = clampf(fv, -12.0f, 12.0f);
+        if (json_get_float(val, "sweep_rate", &fv) == 0)
+            v->sweep_rate = clampf(fv, 0.0f, 20.0f);
+        if (json_get_float(val, "sweep_depth", &fv) == 0)
+            v->sweep_depth = clampf(fv, 0.0f, 12.0f);
+        if (json_get_float(val, "air", &fv) == 0)
+            v->air = clampf(fv, 0.0f, 1.0f);
+        if (json_get_int(val, "air_mode", &iv) == 0)
+            v->air_mode = clampi(iv, 0, AIR_MODE_COUNT - 1);
+        cc_reset(v);
+        /* The tier's settings were restored above; only the label is kept,
+         * and only while they still match it */
+        int saved = -1;
+        if (json_get_int(val, "quality", &iv) == 0)
+            saved = clampi(iv, 0, QUALITY_COUNT - 1);
+        v->quality = restored_quality(v, saved);
 
         clear_filters(v);
         recalc_bands(v);
+        atomic_fetch_add(&v->param_version, 1);
+        return;
+    }
+
+    /* Parameters apply now, memories at the audio thread's next chunk */
+    if (strcmp(key, "dsp_snapshot") == 0) {
+        char state[SNAP_STATE_MAX];
+        int bands = snapshot_decode(v, val, state);
+        if (bands < 0) return;
+        set_param(v, "state", state);
+        if (v->bands == bands)
+            atomic_store_explicit(&v->snap_ready, 1, memory_order_release);
         return;
     }
 
@@ -353,6 +3175,7 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
         int new_bands = snap_bands(clampi((int)fv, 8, 32));
         if (new_bands != v->bands) {
             v->bands = new_bands;
+            v->quality = QUALITY_CUSTOM;
             clear_filters(v);
             recalc_bands(v);
         }
@@ -376,12 +3199,235 @@ static void v2_set_param(void *instance, const char *key, const char *val) {
         v->mix = clampf(fv, 0.0f, 1.0f);
     } else if (strcmp(key, "carrier_mix") == 0) {
         v->carrier_mix = clampf(fv, 0.0f, 1.0f);
+    } else if (strcmp(key, "scale") == 0) {
+        v->scale = parse_enum(val, g_scale_names, SCALE_COUNT);
+        if (v->scale == SCALE_ADAPTIVE) worker_start(v);
+        recalc_bands(v);
+    } else if (strcmp(key, "env_scale") == 0) {
+        v->env_scale = clampf(fv, 0.25f, 4.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "detector") == 0) {
+        int det = parse_enum(val, g_detector_names, DET_COUNT);
+        if (det != v->detector) {
+            v->detector = det;
+            clear_envelopes(v);
+            update_cost(v);
+        }
+    } else if (strcmp(key, "analysis") == 0) {
+        int mode = parse_enum(val, g_analysis_names, ANALYSIS_COUNT);
+        if (mode != v->analysis) {
+            v->analysis = mode;
+            v->quality = QUALITY_CUSTOM;
+            memset(v->mod_quad_l, 0, sizeof(v->mod_quad_l));
+            memset(v->mod_quad_r, 0, sizeof(v->mod_quad_r));
+            recalc_bands(v);
+        }
+    } else if (strcmp(key, "dc_block") == 0) {
+        v->dc_block = parse_enum(val, g_off_on_names, 2);
+        recalc_bands(v);
+    } else if (strcmp(key, "mod_hpf") == 0) {
+        v->mod_hpf = clampf(fv, 0.0f, 300.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "pre_emph") == 0) {
+        v->pre_emph = clampf(fv, 0.0f, 0.95f);
+    } else if (strcmp(key, "whiten") == 0) {
+        v->whiten = clampf(fv, 0.0f, 1.0f);
+        update_cost(v);
+    } else if (strcmp(key, "agc") == 0) {
+        v->agc = parse_enum(val, g_off_on_names, 2);
+    } else if (strcmp(key, "agc_target") == 0) {
+        v->agc_target = clampf(fv, -40.0f, -6.0f);
+    } else if (strcmp(key, "agc_max") == 0) {
+        v->agc_max = clampf(fv, 0.0f, 40.0f);
+    } else if (strcmp(key, "agc_attack") == 0) {
+        v->agc_attack_ms = clampf(fv, 10.0f, 1000.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "agc_release") == 0) {
+        v->agc_release_ms = clampf(fv, 50.0f, 5000.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "gate") == 0) {
+        v->gate = clampf(fv, 0.0f, 1.0f);
+    } else if (strcmp(key, "align") == 0) {
+        v->align_ms = clampf(fv, -ALIGN_MAX_MS, ALIGN_MAX_MS);
+        update_delays(v);
+    } else if (strcmp(key, "tilt") == 0) {
+        v->tilt = clampf(fv, -6.0f, 6.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "presence") == 0) {
+        v->presence = clampf(fv, 0.0f, 12.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "curve") == 0) {
+        set_curve(v, val);
+        recalc_bands(v);
+    } else if (strcmp(key, "stereo") == 0) {
+        int mode = parse_enum(val, g_stereo_names, STEREO_COUNT);
+        if (mode != v->stereo) {
+            v->stereo = mode;
+            v->quality = QUALITY_CUSTOM;
+            clear_filters(v);
+            update_cost(v);
+        }
+    } else if (strcmp(key, "pan_mode") == 0) {
+        v->pan_mode = parse_enum(val, g_pan_names, PAN_COUNT);
+        recalc_bands(v);
+    } else if (strcmp(key, "width") == 0) {
+        v->width = clampf(fv, 0.0f, 1.0f);
+        recalc_bands(v);
+    } else if (strcmp(key, "env_rate") == 0) {
+        int rate = parse_enum(val, g_env_rate_names, ENV_RATE_COUNT);
+        if (rate != v->env_rate) {
+            v->env_rate = rate;
+            v->quality = QUALITY_CUSTOM;
+            recalc_bands(v);
+        }
+    } else if (strcmp(key, "quality") == 0) {
+        apply_quality(v, parse_enum(val, g_quality_names, QUALITY_COUNT));
+    } else if (strcmp(key, "priority") == 0) {
+        v->priority = parse_enum(val, g_priority_names, PRIORITY_COUNT);
+    } else if (strcmp(key, "cpu_budget") == 0) {
+        /* Module-level: shared by every instance in the process */
+        atomic_store(&g_coord_budget_pct, (int)clampf(fv, 10.0f, 100.0f));
+        return;
+    } else if (strcmp(key, "pitch_track") == 0) {
+        int on = parse_enum(val, g_off_on_names, 2);
+        if (on != v->pitch_track) {
+            v->pitch_track = on;
+            v->pitch_chunk = 0;
+            v->pitch_conf = 0.0f;
+            /* Drops the held contribution when switching off */
+            atomic_store_explicit(&v->pitch_retarget, 1, memory_order_release);
+            update_cost(v);
+        }
+    } else if (strcmp(key, "pitch_depth") == 0) {
+        v->pitch_depth = clampf(fv, 0.0f, 1.0f);
+    } else if (strcmp(key, "pitch_target") == 0) {
+        copy_ident(v->pitch_target, val, PITCH_ID_LEN);
+        atomic_store_explicit(&v->pitch_retarget, 1, memory_order_release);
+    } else if (strcmp(key, "pitch_param") == 0) {
+        copy_ident(v->pitch_param, val, PITCH_ID_LEN);
+        atomic_store_explicit(&v->pitch_retarget, 1, memory_order_release);
+    } else if (strcmp(key, "cc_out") == 0) {
+        v->cc_out = parse_enum(val, g_cc_out_names, CC_OUT_COUNT);
+        cc_reset(v);
+    } else if (strcmp(key, "cc_groups") == 0) {
+        v->cc_groups = clampi((int)fv, 2, CC_MAX_GROUPS);
+        v->cc_base = clampi(v->cc_base, 0, 120 - v->cc_groups);
+        cc_reset(v);
+    } else if (strcmp(key, "cc_base") == 0) {
+        v->cc_base = clampi((int)fv, 0, 120 - v->cc_groups);
+        cc_reset(v);
+    } else if (strcmp(key, "cc_channel") == 0) {
+        v->cc_channel = clampi((int)fv, 1, 16);
+        cc_reset(v);
+    } else if (strcmp(key, "cc_rate") == 0) {
+        v->cc_rate = clampf(fv, 5.0f, 100.0f);
+    } else if (strcmp(key, "cc_thresh") == 0) {
+        v->cc_thresh = clampi((int)fv, 1, 16);
+    } else if (strcmp(key, "side_bands") == 0) {
+        int side = parse_enum(val, g_side_names, SIDE_COUNT);
+        if (side != v->side_bands) {
+            v->side_bands = side;
+            memset(v->side_svf, 0, sizeof(v->side_svf));
+            recalc_bands(v);
+            update_side(v, 0, v->bands);
+        }
+    } else if (strcmp(key, "formant") == 0) {
+        v->formant = clampf(fv, -12.0f, 12.0f);
+        update_cost(v);
+    } else if (strcmp(key, "sweep_rate") == 0) {
+        v->sweep_rate = clampf(fv, 0.0f, 20.0f);
+    } else if (strcmp(key, "sweep_depth") == 0) {
+        v->sweep_depth = clampf(fv, 0.0f, 12.0f);
+        update_cost(v);
+    } else if (strcmp(key, "air") == 0) {
+        float air = clampf(fv, 0.0f, 1.0f);
+        if (air > 0.0f && v->air <= 0.0f)
+            clear_air(v);
+        v->air = air;
+        update_cost(v);
+    } else if (strcmp(key, "air_mode") == 0) {
+        v->air_mode = parse_enum(val, g_air_mode_names, AIR_MODE_COUNT);
+    } else if (strcmp(key, "adapt_reset") == 0) {
+        /* Forget the learned spectrum; bands stay put until relearned */
+        if (atoi(val)) atomic_store(&v->adapt_reset, 1);
+        return;
+    } else if (strcmp(key, "align_detect") == 0) {
+        /* Record ~1.5 s of both signals, then the worker estimates 'align' */
+        if (atoi(val)) {
+            worker_start(v);
+            atomic_store(&v->align_request, ALIGN_REQ_START);
+        } else {
+            atomic_store(&v->align_request, ALIGN_REQ_STOP);
+        }
+        return;
+    } else {
+        return;
     }
+    atomic_fetch_add(&v->param_version, 1);
 }
 
-static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
-    vocoder_instance_t *v = (vocoder_instance_t *)instance;
-    if (!v) return -1;
+/*
+ * Chain params metadata for shadow parameter editor, prebuilt so a poll
+ * is a memcpy. The full list is about 4.6 KB; a host buffer too small for
+ * it gets the core group (the main page plus Quality, about 1 KB) rather
+ * than nothing.
+ */
+#define CHAIN_CORE_JSON \
+    "{\"key\":\"bands\",\"name\":\"Bands\",\"type\":\"enum\",\"options\":[\"8\",\"16\",\"24\",\"32\"],\"default\":\"16\"}," \
+    "{\"key\":\"freq_low\",\"name\":\"Low Freq\",\"type\":\"float\",\"min\":80,\"max\":500,\"default\":100,\"step\":10,\"unit\":\"Hz\"}," \
+    "{\"key\":\"freq_high\",\"name\":\"High Freq\",\"type\":\"float\",\"min\":2000,\"max\":12000,\"default\":8000,\"step\":100,\"unit\":\"Hz\"}," \
+    "{\"key\":\"attack\",\"name\":\"Attack\",\"type\":\"float\",\"min\":0.1,\"max\":50,\"default\":5,\"step\":0.5,\"unit\":\"ms\"}," \
+    "{\"key\":\"release\",\"name\":\"Release\",\"type\":\"float\",\"min\":5,\"max\":500,\"default\":50,\"step\":5,\"unit\":\"ms\"}," \
+    "{\"key\":\"mod_gain\",\"name\":\"Mod Gain\",\"type\":\"float\",\"min\":0,\"max\":6,\"default\":2,\"step\":0.1}," \
+    "{\"key\":\"output_gain\",\"name\":\"Out Gain\",\"type\":\"float\",\"min\":0,\"max\":6,\"default\":2,\"step\":0.1}," \
+    "{\"key\":\"mix\",\"name\":\"Mix\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":1,\"step\":0.01}," \
+    "{\"key\":\"carrier_mix\",\"name\":\"Unvoiced\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0.1,\"step\":0.01}," \
+    "{\"key\":\"quality\",\"name\":\"Quality\",\"type\":\"enum\",\"options\":[\"Custom\",\"Eco\",\"Standard\",\"High\",\"Ultra\"],\"default\":\"Standard\"}"
+
+#define CHAIN_MORE_JSON \
+    "{\"key\":\"scale\",\"name\":\"Scale\",\"type\":\"enum\",\"options\":[\"Log\",\"Bark\",\"ERB\",\"Mel\",\"Linear\",\"Adaptive\"],\"default\":\"Log\"}," \
+    "{\"key\":\"env_scale\",\"name\":\"Env Scale\",\"type\":\"float\",\"min\":0.25,\"max\":4,\"default\":1,\"step\":0.05,\"unit\":\"x\"}," \
+    "{\"key\":\"detector\",\"name\":\"Detector\",\"type\":\"enum\",\"options\":[\"Peak\",\"RMS\",\"Log\"],\"default\":\"Peak\"}," \
+    "{\"key\":\"analysis\",\"name\":\"Analysis\",\"type\":\"enum\",\"options\":[\"Real\",\"Quad\"],\"default\":\"Real\"}," \
+    "{\"key\":\"dc_block\",\"name\":\"DC Block\",\"type\":\"enum\",\"options\":[\"Off\",\"On\"],\"default\":\"Off\"}," \
+    "{\"key\":\"mod_hpf\",\"name\":\"Mod HPF\",\"type\":\"float\",\"min\":0,\"max\":300,\"default\":0,\"step\":10,\"unit\":\"Hz\"}," \
+    "{\"key\":\"pre_emph\",\"name\":\"Pre-Emph\",\"type\":\"float\",\"min\":0,\"max\":0.95,\"default\":0,\"step\":0.05}," \
+    "{\"key\":\"whiten\",\"name\":\"Whiten\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0,\"step\":0.05}," \
+    "{\"key\":\"agc\",\"name\":\"Auto Gain\",\"type\":\"enum\",\"options\":[\"Off\",\"On\"],\"default\":\"Off\"}," \
+    "{\"key\":\"agc_target\",\"name\":\"AGC Target\",\"type\":\"float\",\"min\":-40,\"max\":-6,\"default\":-20,\"step\":1,\"unit\":\"dB\"}," \
+    "{\"key\":\"agc_max\",\"name\":\"AGC Max\",\"type\":\"float\",\"min\":0,\"max\":40,\"default\":20,\"step\":1,\"unit\":\"dB\"}," \
+    "{\"key\":\"agc_attack\",\"name\":\"AGC Attack\",\"type\":\"float\",\"min\":10,\"max\":1000,\"default\":50,\"step\":10,\"unit\":\"ms\"}," \
+    "{\"key\":\"agc_release\",\"name\":\"AGC Release\",\"type\":\"float\",\"min\":50,\"max\":5000,\"default\":500,\"step\":50,\"unit\":\"ms\"}," \
+    "{\"key\":\"gate\",\"name\":\"Noise Gate\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0,\"step\":0.05}," \
+    "{\"key\":\"align\",\"name\":\"Align\",\"type\":\"float\",\"min\":-50,\"max\":50,\"default\":0,\"step\":0.5,\"unit\":\"ms\"}," \
+    "{\"key\":\"tilt\",\"name\":\"Tilt\",\"type\":\"float\",\"min\":-6,\"max\":6,\"default\":0,\"step\":0.5,\"unit\":\"dB/oct\"}," \
+    "{\"key\":\"presence\",\"name\":\"Presence\",\"type\":\"float\",\"min\":0,\"max\":12,\"default\":0,\"step\":0.5,\"unit\":\"dB\"}," \
+    "{\"key\":\"stereo\",\"name\":\"Stereo\",\"type\":\"enum\",\"options\":[\"Dual\",\"Spread\",\"M/S\"],\"default\":\"Dual\"}," \
+    "{\"key\":\"pan_mode\",\"name\":\"Pan Pattern\",\"type\":\"enum\",\"options\":[\"Alternate\",\"Spiral\",\"Random\"],\"default\":\"Alternate\"}," \
+    "{\"key\":\"width\",\"name\":\"Width\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0.7,\"step\":0.05}," \
+    "{\"key\":\"env_rate\",\"name\":\"Env Rate\",\"type\":\"enum\",\"options\":[\"Fine\",\"Normal\",\"Coarse\"],\"default\":\"Normal\"}," \
+    "{\"key\":\"priority\",\"name\":\"CPU Priority\",\"type\":\"enum\",\"options\":[\"Low\",\"Normal\",\"High\"],\"default\":\"Normal\"}," \
+    "{\"key\":\"pitch_track\",\"name\":\"Pitch Track\",\"type\":\"enum\",\"options\":[\"Off\",\"On\"],\"default\":\"Off\"}," \
+    "{\"key\":\"pitch_depth\",\"name\":\"Pitch Depth\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":1,\"step\":0.05}," \
+    "{\"key\":\"cc_out\",\"name\":\"CC Out\",\"type\":\"enum\",\"options\":[\"Off\",\"Internal\",\"External\",\"Both\"],\"default\":\"Off\"}," \
+    "{\"key\":\"cc_groups\",\"name\":\"CC Groups\",\"type\":\"float\",\"min\":2,\"max\":8,\"default\":4,\"step\":1}," \
+    "{\"key\":\"cc_base\",\"name\":\"CC First\",\"type\":\"float\",\"min\":0,\"max\":118,\"default\":20,\"step\":1}," \
+    "{\"key\":\"cc_channel\",\"name\":\"CC Channel\",\"type\":\"float\",\"min\":1,\"max\":16,\"default\":1,\"step\":1}," \
+    "{\"key\":\"cc_rate\",\"name\":\"CC Rate\",\"type\":\"float\",\"min\":5,\"max\":100,\"default\":30,\"step\":5,\"unit\":\"Hz\"}," \
+    "{\"key\":\"cc_thresh\",\"name\":\"CC Threshold\",\"type\":\"float\",\"min\":1,\"max\":16,\"default\":2,\"step\":1}," \
+    "{\"key\":\"air\",\"name\":\"Air\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0,\"step\":0.05}," \
+    "{\"key\":\"air_mode\",\"name\":\"Air Mode\",\"type\":\"enum\",\"options\":[\"Direct\",\"Noise\"],\"default\":\"Direct\"}," \
+    "{\"key\":\"side_bands\",\"name\":\"Side Bands\",\"type\":\"enum\",\"options\":[\"1/2\",\"1/4\",\"1/8\"],\"default\":\"1/4\"}," \
+    "{\"key\":\"formant\",\"name\":\"Formant\",\"type\":\"float\",\"min\":-12,\"max\":12,\"default\":0,\"step\":0.5,\"unit\":\"st\"}," \
+    "{\"key\":\"sweep_rate\",\"name\":\"Sweep Rate\",\"type\":\"float\",\"min\":0,\"max\":20,\"default\":0,\"step\":0.05,\"unit\":\"Hz\"}," \
+    "{\"key\":\"sweep_depth\",\"name\":\"Sweep Depth\",\"type\":\"float\",\"min\":0,\"max\":12,\"default\":0,\"step\":0.5,\"unit\":\"st\"}"
+
+static const char g_chain_params_full[] = "[" CHAIN_CORE_JSON "," CHAIN_MORE_JSON "]";
+static const char g_chain_params_core[] = "[" CHAIN_CORE_JSON "]";
+static atomic_int g_chain_params_warned;
+
+/* Parameter, metadata and meter reads; callers hold v->lock */
+static int get_param(vocoder_instance_t *v, const char *key, char *buf, int buf_len) {
 
     if (strcmp(key, "name") == 0) {
         return snprintf(buf, buf_len, "Vocoder");
@@ -406,55 +3452,226 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
         return snprintf(buf, buf_len, "%.2f", v->mix);
     if (strcmp(key, "carrier_mix") == 0)
         return snprintf(buf, buf_len, "%.2f", v->carrier_mix);
+    if (strcmp(key, "scale") == 0)
+        return snprintf(buf, buf_len, "%s", g_scale_names[v->scale]);
+    if (strcmp(key, "env_scale") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->env_scale);
+    if (strcmp(key, "detector") == 0)
+        return snprintf(buf, buf_len, "%s", g_detector_names[v->detector]);
+    if (strcmp(key, "analysis") == 0)
+        return snprintf(buf, buf_len, "%s", g_analysis_names[v->analysis]);
+    if (strcmp(key, "dc_block") == 0)
+        return snprintf(buf, buf_len, "%s", g_off_on_names[v->dc_block]);
+    if (strcmp(key, "mod_hpf") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->mod_hpf);
+    if (strcmp(key, "pre_emph") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->pre_emph);
+    if (strcmp(key, "whiten") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->whiten);
+    if (strcmp(key, "gate") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->gate);
+    if (strcmp(key, "align") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->align_ms);
+    if (strcmp(key, "stereo") == 0)
+        return snprintf(buf, buf_len, "%s", g_stereo_names[v->stereo]);
+    if (strcmp(key, "pan_mode") == 0)
+        return snprintf(buf, buf_len, "%s", g_pan_names[v->pan_mode]);
+    if (strcmp(key, "width") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->width);
+    if (strcmp(key, "tilt") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->tilt);
+    if (strcmp(key, "presence") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->presence);
+    if (strcmp(key, "curve") == 0)
+        return snprintf(buf, buf_len, "%.1f,%.1f,%.1f,%.1f,%.1f",
+                        v->curve[0], v->curve[1], v->curve[2], v->curve[3], v->curve[4]);
+    if (strcmp(key, "agc") == 0)
+        return snprintf(buf, buf_len, "%s", g_off_on_names[v->agc]);
+    if (strcmp(key, "agc_target") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->agc_target);
+    if (strcmp(key, "agc_max") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->agc_max);
+    if (strcmp(key, "agc_attack") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->agc_attack_ms);
+    if (strcmp(key, "agc_release") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->agc_release_ms);
+    if (strcmp(key, "quality") == 0)
+        return snprintf(buf, buf_len, "%s", g_quality_names[v->quality]);
+    if (strcmp(key, "env_rate") == 0)
+        return snprintf(buf, buf_len, "%s", g_env_rate_names[v->env_rate]);
+    if (strcmp(key, "priority") == 0)
+        return snprintf(buf, buf_len, "%s", g_priority_names[v->priority]);
+    if (strcmp(key, "cpu_budget") == 0)
+        return snprintf(buf, buf_len, "%d", atomic_load(&g_coord_budget_pct));
+    if (strcmp(key, "pitch_track") == 0)
+        return snprintf(buf, buf_len, "%s", g_off_on_names[v->pitch_track]);
+    if (strcmp(key, "pitch_depth") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->pitch_depth);
+    if (strcmp(key, "cc_out") == 0)
+        return snprintf(buf, buf_len, "%s", g_cc_out_names[v->cc_out]);
+    if (strcmp(key, "cc_groups") == 0)
+        return snprintf(buf, buf_len, "%d", v->cc_groups);
+    if (strcmp(key, "cc_base") == 0)
+        return snprintf(buf, buf_len, "%d", v->cc_base);
+    if (strcmp(key, "cc_channel") == 0)
+        return snprintf(buf, buf_len, "%d", v->cc_channel);
+    if (strcmp(key, "cc_rate") == 0)
+        return snprintf(buf, buf_len, "%.0f", v->cc_rate);
+    if (strcmp(key, "side_bands") == 0)
+        return snprintf(buf, buf_len, "%s", g_side_names[v->side_bands]);
+    if (strcmp(key, "formant") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->formant);
+    if (strcmp(key, "sweep_rate") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->sweep_rate);
+    if (strcmp(key, "sweep_depth") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->sweep_depth);
+    if (strcmp(key, "air") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->air);
+    if (strcmp(key, "air_mode") == 0)
+        return snprintf(buf, buf_len, "%s", g_air_mode_names[v->air_mode]);
+    if (strcmp(key, "cc_thresh") == 0)
+        return snprintf(buf, buf_len, "%d", v->cc_thresh);
+    if (strcmp(key, "pitch_target") == 0)
+        return snprintf(buf, buf_len, "%s", v->pitch_target);
+    if (strcmp(key, "pitch_param") == 0)
+        return snprintf(buf, buf_len, "%s", v->pitch_param);
+
+    /* Read-only meters, updated by the audio thread once per chunk */
+    if (strcmp(key, "input_level") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->input_level_db);
+    if (strcmp(key, "align_status") == 0)
+        return snprintf(buf, buf_len, "%s", g_align_status_names[atomic_load(&v->align_status)]);
+    if (strcmp(key, "align_corr") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->align_corr);
+    if (strcmp(key, "latency_samples") == 0)
+        return snprintf(buf, buf_len, "%d", v->latency);
+    if (strcmp(key, "engine") == 0)
+        return snprintf(buf, buf_len, "%s", g_engines[v->engine].name);
+    if (strcmp(key, "pitch_hz") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->pitch_hz);
+    if (strcmp(key, "pitch_conf") == 0)
+        return snprintf(buf, buf_len, "%.2f", v->pitch_conf);
+    if (strcmp(key, "band_centers") == 0) {
+        int len = 0;
+        for (int b = 0; b < v->bands && len < buf_len; b++)
+            len += snprintf(buf + len, buf_len - len, b ? ",%.0f" : "%.0f", v->band_fc[b]);
+        return (len < buf_len) ? len : -1;
+    }
+    if (strcmp(key, "active_bands") == 0)
+        return snprintf(buf, buf_len, "%d", v->active_count);
+    if (strcmp(key, "agc_gain") == 0)
+        return snprintf(buf, buf_len, "%.1f", v->agc ? v->agc_gain_db : 0.0f);
+
+    /* Predicted ns per MAX_BLOCK frames with every band open, for overload warnings */
+    if (strcmp(key, "cpu_cost") == 0) {
+        float units = v->cost_fixed + (float)v->bands * v->cost_band;
+        return snprintf(buf, buf_len, "%.0f", units * (float)MAX_BLOCK * v->ns_per_unit);
+    }
+    if (strcmp(key, "cpu_level") == 0)
+        return snprintf(buf, buf_len, "%s", g_cpu_level_names[v->cpu_level]);
+    if (strcmp(key, "cpu_total") == 0) {
+        int total = 0;
+        for (int i = 0; i < COORD_SLOTS; i++)
+            if (atomic_load(&g_coord_slots[i].used))
+                total += atomic_load(&g_coord_slots[i].cost_ns);
+        return snprintf(buf, buf_len, "%d", total);
+    }
+    if (strcmp(key, "profile") == 0)
+        return snprintf(buf, buf_len,
+            "{\"avg_ns\":%.0f,\"max_ns\":%.0f,\"ns_per_unit\":%.3f,\"budget_ns\":%.0f,"
+            "\"pitch_ns\":%.0f}",
+            v->block_ns_avg, v->block_ns_max, v->ns_per_unit,
+            1e9f * (float)MAX_BLOCK / (float)SAMPLE_RATE,
+            v->pitch_track ? v->pitch_ns : 0.0f);
 
-    /* Full state for patch save/restore */
+    /* Lets the UI skip polling while nothing has changed */
+    if (strcmp(key, "param_version") == 0)
+        return snprintf(buf, buf_len, "%u", atomic_load(&v->param_version));
+
+    /* Full state for patch save/restore, formatted once per version */
     if (strcmp(key, "state") == 0) {
-        return snprintf(buf, buf_len,
+        unsigned ver = atomic_load(&v->param_version);
+        if (v->state_version != ver) {
+            v->state_len = snprintf(v->state_cache, sizeof(v->state_cache),
             "{\"bands\":%d,\"freq_low\":%.1f,\"freq_high\":%.1f,"
             "\"attack\":%.1f,\"release\":%.1f,\"mod_gain\":%.2f,"
-            "\"output_gain\":%.2f,\"mix\":%.2f,\"carrier_mix\":%.2f}",
+            "\"output_gain\":%.2f,\"mix\":%.2f,\"carrier_mix\":%.2f,"
+            "\"scale\":%d,\"env_scale\":%.2f,\"detector\":%d,"
+            "\"analysis\":%d,\"dc_block\":%d,\"mod_hpf\":%.1f,\"pre_emph\":%.2f,"
+            "\"whiten\":%.2f,\"agc\":%d,\"agc_target\":%.1f,\"agc_max\":%.1f,"
+            "\"agc_attack\":%.1f,\"agc_release\":%.1f,\"gate\":%.2f,"
+            "\"align\":%.1f,\"tilt\":%.1f,\"presence\":%.1f,"
+            "\"curve\":\"%.1f,%.1f,%.1f,%.1f,%.1f\",\"stereo\":%d,\"pan_mode\":%d,"
+            "\"width\":%.2f,\"quality\":%d,\"env_rate\":%d,"
+            "\"priority\":%d,\"pitch_track\":%d,\"pitch_depth\":%.2f,"
+            "\"pitch_target\":\"%s\",\"pitch_param\":\"%s\",\"cc_out\":%d,\"cc_groups\":%d,"
+            "\"cc_base\":%d,\"cc_channel\":%d,\"cc_rate\":%.0f,\"cc_thresh\":%d,"
+            "\"air\":%.2f,\"air_mode\":%d,\"side_bands\":%d,\"formant\":%.1f,"
+            "\"sweep_rate\":%.2f,\"sweep_depth\":%.1f}",
             v->bands, v->freq_low, v->freq_high,
             v->attack_ms, v->release_ms, v->mod_gain,
-            v->output_gain, v->mix, v->carrier_mix);
+            v->output_gain, v->mix, v->carrier_mix,
+            v->scale, v->env_scale, v->detector,
+            v->analysis, v->dc_block, v->mod_hpf, v->pre_emph,
+            v->whiten, v->agc, v->agc_target, v->agc_max,
+            v->agc_attack_ms, v->agc_release_ms, v->gate,
+            v->align_ms, v->tilt, v->presence,
+            v->curve[0], v->curve[1], v->curve[2], v->curve[3], v->curve[4],
+            v->stereo, v->pan_mode, v->width, v->quality, v->env_rate,
+            v->priority, v->pitch_track, v->pitch_depth,
+            v->pitch_target, v->pitch_param, v->cc_out, v->cc_groups,
+            v->cc_base, v->cc_channel, v->cc_rate, v->cc_thresh,
+            v->air, v->air_mode, v->side_bands, v->formant,
+            v->sweep_rate, v->sweep_depth);
+            v->state_version = ver;
+        }
+        int len = v->state_len;
+        if (len < 0 || len >= (int)sizeof(v->state_cache) || len >= buf_len)
+            return -1;
+        memcpy(buf, v->state_cache, len + 1);
+        return len;
+    }
+
+    /* Parameters plus filter/envelope memories, base64. Reached through
+     * v2_get_param, which holds v->lock for the whole encode, the same lock
+     * process_block takes; never call it from the audio thread */
+    if (strcmp(key, "dsp_snapshot") == 0) {
+        char state[SNAP_STATE_MAX];
+        if (get_param(v, "state", state, sizeof(state)) < 0) return -1;
+        return snapshot_encode(v, state, buf, buf_len);
     }
 
     /* Shadow UI hierarchy */
     if (strcmp(key, "ui_hierarchy") == 0) {
-        const char *hierarchy = "{"
+        static const char hierarchy[] = "{"
             "\"modes\":null,"
             "\"levels\":{"
                 "\"root\":{"
                     "\"children\":null,"
                     "\"knobs\":[\"mod_gain\",\"output_gain\",\"bands\",\"mix\",\"freq_low\",\"freq_high\",\"attack\",\"release\"],"
-                    "\"params\":[\"mod_gain\",\"output_gain\",\"bands\",\"mix\",\"freq_low\",\"freq_high\",\"attack\",\"release\",\"carrier_mix\"]"
+                    "\"params\":[\"mod_gain\",\"output_gain\",\"bands\",\"mix\",\"freq_low\",\"freq_high\",\"attack\",\"release\",\"carrier_mix\",\"scale\",\"env_scale\",\"detector\",\"analysis\",\"dc_block\",\"mod_hpf\",\"pre_emph\",\"whiten\",\"agc\",\"agc_target\",\"agc_max\",\"agc_attack\",\"agc_release\",\"gate\",\"align\",\"tilt\",\"presence\",\"stereo\",\"pan_mode\",\"width\",\"quality\",\"env_rate\",\"priority\",\"pitch_track\",\"pitch_depth\",\"cc_out\",\"cc_groups\",\"cc_base\",\"cc_channel\",\"cc_rate\",\"cc_thresh\",\"air\",\"air_mode\",\"side_bands\",\"formant\",\"sweep_rate\",\"sweep_depth\"]"
                 "}"
             "}"
         "}";
-        int len = strlen(hierarchy);
+        int len = (int)sizeof(hierarchy) - 1;
         if (len < buf_len) {
-            strcpy(buf, hierarchy);
+            memcpy(buf, hierarchy, sizeof(hierarchy));
             return len;
         }
         return -1;
     }
 
-    /* Chain params metadata for shadow parameter editor */
+    /* Chain params metadata, or the core group if the buffer is short */
     if (strcmp(key, "chain_params") == 0) {
-        const char *params_json = "["
-            "{\"key\":\"bands\",\"name\":\"Bands\",\"type\":\"enum\",\"options\":[\"8\",\"16\",\"24\",\"32\"],\"default\":\"16\"},"
-            "{\"key\":\"freq_low\",\"name\":\"Low Freq\",\"type\":\"float\",\"min\":80,\"max\":500,\"default\":100,\"step\":10,\"unit\":\"Hz\"},"
-            "{\"key\":\"freq_high\",\"name\":\"High Freq\",\"type\":\"float\",\"min\":2000,\"max\":12000,\"default\":8000,\"step\":100,\"unit\":\"Hz\"},"
-            "{\"key\":\"attack\",\"name\":\"Attack\",\"type\":\"float\",\"min\":0.1,\"max\":50,\"default\":5,\"step\":0.5,\"unit\":\"ms\"},"
-            "{\"key\":\"release\",\"name\":\"Release\",\"type\":\"float\",\"min\":5,\"max\":500,\"default\":50,\"step\":5,\"unit\":\"ms\"},"
-            "{\"key\":\"mod_gain\",\"name\":\"Mod Gain\",\"type\":\"float\",\"min\":0,\"max\":6,\"default\":2,\"step\":0.1},"
-            "{\"key\":\"output_gain\",\"name\":\"Out Gain\",\"type\":\"float\",\"min\":0,\"max\":6,\"default\":2,\"step\":0.1},"
-            "{\"key\":\"mix\",\"name\":\"Mix\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":1,\"step\":0.01},"
-            "{\"key\":\"carrier_mix\",\"name\":\"Unvoiced\",\"type\":\"float\",\"min\":0,\"max\":1,\"default\":0.1,\"step\":0.01}"
-        "]";
-        int len = strlen(params_json);
-        if (len < buf_len) {
-            strcpy(buf, params_json);
-            return len;
+        if ((int)sizeof(g_chain_params_full) <= buf_len) {
+            memcpy(buf, g_chain_params_full, sizeof(g_chain_params_full));
+            return (int)sizeof(g_chain_params_full) - 1;
+        }
+        if (!atomic_exchange(&g_chain_params_warned, 1))
+            voc_log("chain_params: host buffer too small, sending core parameters only");
+        if ((int)sizeof(g_chain_params_core) <= buf_len) {
+            memcpy(buf, g_chain_params_core, sizeof(g_chain_params_core));
+            return (int)sizeof(g_chain_params_core) - 1;
         }
         return -1;
     }
@@ -462,6 +3679,23 @@ static int v2_get_param(void *instance, const char *key, char *buf, int buf_len)
     return -1;
 }
 
+static void v2_set_param(void *instance, const char *key, const char *val) {
+    vocoder_instance_t *v = (vocoder_instance_t *)instance;
+    if (!v) return;
+    pthread_mutex_lock(&v->lock);
+    set_param(v, key, val);
+    pthread_mutex_unlock(&v->lock);
+}
+
+static int v2_get_param(void *instance, const char *key, char *buf, int buf_len) {
+    vocoder_instance_t *v = (vocoder_instance_t *)instance;
+    if (!v) return -1;
+    pthread_mutex_lock(&v->lock);
+    int len = get_param(v, key, buf, buf_len);
+    pthread_mutex_unlock(&v->lock);
+    return len;
+}
+
 /* ── Entry point ─────────────────────────────────────────────────────── */
 
 static audio_fx_api_v2_t g_fx_api_v2;